@@ -0,0 +1,103 @@
+/******************************************************************************
+benchmark.cpp
+Host micro-benchmark of Timestamp <-> time_t conversion against the libc path, run by `make bench`
+Bobby Schulz @ GEMS Sensing
+
+toUnix() is timed against glibc timegm() and against the TZ swap around mktime() which the driver used before
+(reproduced below), fromUnix() against gmtime_r(). getTimeUnix() is timed through MCP79412MemoryBus, so the figure
+is the cost of a timestamp in the log pipeline less the I2C transfer itself. Results are per call, the inputs
+change every call so nothing is hoisted out of the loops
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#include "MCP79412.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+constexpr static int ITERATIONS = 2000000;
+static volatile int64_t Sink = 0; //Keeps results live
+
+/**
+ * The conversion MCP79412 used before toUnix(), UTC by clearing TZ around mktime()
+ */
+static time_t swapTimegm(struct tm *tm)
+{
+	time_t Ret;
+	char *Tz = getenv("TZ");
+	setenv("TZ", "", 1);
+	tzset();
+	Ret = mktime(tm);
+	if(Tz) setenv("TZ", Tz, 1);
+	else unsetenv("TZ");
+	tzset();
+	return Ret;
+}
+
+static MCP79412::Timestamp input(int i)
+{
+	return {(uint16_t)(2000 + i % 99), (uint8_t)(1 + i % 12), (uint8_t)(1 + i % 28), 1, (uint8_t)(i % 24), (uint8_t)(i % 60), (uint8_t)((i/60) % 60)};
+}
+
+static struct tm inputTm(int i)
+{
+	MCP79412::Timestamp t = input(i);
+	struct tm Tm = {};
+	Tm.tm_year = t.year - 1900;
+	Tm.tm_mon = t.month - 1;
+	Tm.tm_mday = t.mday;
+	Tm.tm_hour = t.hour;
+	Tm.tm_min = t.min;
+	Tm.tm_sec = t.sec;
+	return Tm;
+}
+
+/**
+ * Time a loop of Count calls
+ *
+ * @return double, time per call [ns]
+ */
+template <class F>
+static double perCall(int Count, F Body)
+{
+	Clock::time_point Start = Clock::now();
+	for(int i = 0; i < Count; i++) Body(i);
+	return std::chrono::duration<double, std::nano>(Clock::now() - Start).count()/Count;
+}
+
+int main()
+{
+	for(int i = 0; i < 100000; i++) { //Same answers before timing anything
+		struct tm Tm = inputTm(i);
+		if(MCP79412::toUnix(input(i)) != timegm(&Tm)) {
+			printf("toUnix differs from timegm at input %d\n", i);
+			return 1;
+		}
+	}
+
+	double ToUnix = perCall(ITERATIONS, [](int i) {Sink += MCP79412::toUnix(input(i));});
+	double Timegm = perCall(ITERATIONS, [](int i) {struct tm Tm = inputTm(i); Sink += timegm(&Tm);});
+	double Swap = perCall(ITERATIONS/10, [](int i) {struct tm Tm = inputTm(i); Sink += swapTimegm(&Tm);}); //Slow, fewer calls
+	double FromUnix = perCall(ITERATIONS, [](int i) {Sink += MCP79412::fromUnix(946684800LL + i*1337LL).mday;});
+	double Gmtime = perCall(ITERATIONS, [](int i) {time_t t = 946684800LL + i*1337LL; struct tm Tm; gmtime_r(&t, &Tm); Sink += Tm.tm_mday;});
+
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	Rtc.setTime(2024, 6, 1, 6, 12, 0, 0);
+	double GetTime = perCall(ITERATIONS/10, [&](int) {Sink += Rtc.getTimeUnix();});
+
+	printf("Timestamp -> time_t\n");
+	printf("  MCP79412::toUnix        %7.1f ns\n", ToUnix);
+	printf("  timegm                  %7.1f ns\n", Timegm);
+	printf("  TZ swap around mktime   %7.1f ns\n", Swap);
+	printf("time_t -> Timestamp\n");
+	printf("  MCP79412::fromUnix      %7.1f ns\n", FromUnix);
+	printf("  gmtime_r                %7.1f ns\n", Gmtime);
+	printf("getTimeUnix() on MCP79412MemoryBus  %7.1f ns\n", GetTime);
+	return 0;
+}
@@ -0,0 +1,639 @@
+/******************************************************************************
+check.cpp
+Host checks of the driver against MCP79412MemoryBus, run by `make check`
+Bobby Schulz @ GEMS Sensing
+
+Covers the behaviour which is quoted in terms of bus traffic or numbers rather than being obvious from the code:
+calendar conversion against libc, the cost of a recurring alarm wake, the timer scheduler across wakes and a reset,
+the bus traffic of waiting for a seconds edge, power-fail stamps across a new year, journal wear leveling and recovery,
+trim calibration and its persistence, the error queue and its SRAM copy, that the compile-time alarm handles drive the
+device exactly as the bool API does, and lock contention seen by a bus which can not try-lock.
+Needs the full configuration.
+Prints each failed check and exits with the number of failures
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#include "MCP79412.h"
+#include "MCP79412_Scheduler.h"
+#include "MCP79412_Codec.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <chrono>
+
+#if defined(MCP79412_LEAN)
+	#error "Host checks need the full configuration"
+#endif
+
+static int Failures = 0;
+
+#define CHECK(Cond) do { if(!(Cond)) {printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #Cond); Failures++;} } while(0)
+
+/**
+ * Transport which NACKs a given number of writes, for the recovery paths, and can have an alarm match mid-transfer
+ */
+class FlakyBus : public MCP79412MemoryBus
+{
+	public:
+		int failWrites = 0;
+		uint8_t raiseAfterWrite = 0; //ALMxWKDAY to flag after the next write, 0 for none
+
+	protected:
+		int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) override
+		{
+			if(failWrites > 0) {
+				failWrites--;
+				return 2; //NACK on address
+			}
+			int Error = MCP79412MemoryBus::writeRegs(Adr, Reg, Data, Len);
+			if(raiseAfterWrite != 0) {
+				rtc[raiseAfterWrite] |= MCP79412Regs::ALMIF;
+				raiseAfterWrite = 0;
+			}
+			return Error;
+		}
+};
+
+/**
+ * Transport whose lock can not be tested, as on Particle, so contention is only known from the wait
+ */
+class BlockingBus : public MCP79412MemoryBus
+{
+	protected:
+		bool tryLockBus() override {lockBus(); return true;}
+};
+
+static void setClock(MCP79412 &Rtc, time_t Time)
+{
+	MCP79412::Timestamp t = MCP79412::fromUnix(Time);
+	Rtc.setTime(t.year, t.month, t.mday, t.wday, t.hour, t.min, t.sec);
+}
+
+/**
+ * toUnix/fromUnix against timegm/gmtime_r, every 7777 s from 1967 to 2100 (user-008)
+ */
+static void checkCalendar()
+{
+	int Mismatch = 0;
+	for(time_t t = -86400LL*800; t < 4102444800LL; t += 7777) {
+		struct tm Ref;
+		gmtime_r(&t, &Ref);
+		MCP79412::Timestamp ts = MCP79412::fromUnix(t);
+		if(ts.year != Ref.tm_year + 1900 || ts.month != Ref.tm_mon + 1 || ts.mday != Ref.tm_mday || ts.hour != Ref.tm_hour
+			|| ts.min != Ref.tm_min || ts.sec != Ref.tm_sec || ts.wday != (Ref.tm_wday == 0 ? 7 : Ref.tm_wday)) Mismatch++;
+		if(MCP79412::toUnix(ts) != t || timegm(&Ref) != t) Mismatch++;
+	}
+	CHECK(Mismatch == 0);
+}
+
+/**
+ * Let a recurring alarm fire and service it, the wake must be one burst read, one write and the flag check (user-019)
+ *
+ * @return uint32_t, bytes written by the wake, 0 if the wake did not behave
+ */
+static uint32_t recurringWake(MCP79412MemoryBus &Mem, MCP79412 &Rtc)
+{
+	MCP79412::AlarmInfo Info;
+	Rtc.getAlarm(0, Info);
+	time_t Match = Info.next;
+	setClock(Rtc, Match);
+	Mem.rtc[MCP79412Regs::Alarm<0>::WKDAY] |= MCP79412Regs::ALMIF; //Device matched
+	Rtc.handleInterrupt();
+	Mem.resetStats();
+	int Fired = Rtc.serviceAlarms();
+	MCP79412Bus::Stats Wake = Mem.getStats();
+	Rtc.getAlarm(0, Info);
+	CHECK(Fired == 1);
+	CHECK(Wake.transactions == 3);
+	CHECK(!Info.flag);
+	CHECK(!Rtc.alarmPending());
+	return (Fired == 1 && Wake.transactions == 3) ? Wake.bytesWritten : 0;
+}
+
+static void checkRecurring()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	setClock(Rtc, MCP79412::toUnix({2024, 3, 4, 1, 12, 3, 20}));
+
+	CHECK(Rtc.setRecurringAlarm(300) == 0); //5 minutes, minutes register moves
+	for(int i = 0; i < 3; i++) CHECK(recurringWake(Mem, Rtc) == 3); //Minutes, hours, weekday
+	CHECK(Rtc.setRecurringAlarm(3600, 600) == 0); //Hourly at 10 past, minutes match does not move
+	for(int i = 0; i < 3; i++) CHECK(recurringWake(Mem, Rtc) == 1); //Weekday only, to clear the flag
+	CHECK(Rtc.setRecurringAlarm(20) == 0); //Seconds register moves, then weekday, the write is contiguous
+	for(int i = 0; i < 3; i++) CHECK(recurringWake(Mem, Rtc) == 4);
+
+	FlakyBus Flaky; //A failed re-arm must not cancel the recurrence
+	MCP79412 Rtc2(Flaky);
+	setClock(Rtc2, MCP79412::toUnix({2024, 5, 1, 3, 10, 0, 0}));
+	CHECK(Rtc2.setRecurringAlarm(60) == 0);
+	Flaky.failWrites = 1;
+	CHECK(Rtc2.rearmRecurring() != 0);
+	CHECK(Rtc2.rearmRecurring() == 0);
+	CHECK(Rtc2.setMode(MCP79412::Mode::Inverted) == 0);
+	CHECK(Rtc2.rearmRecurring() == 0);
+	CHECK(Rtc2.commitAlarm(MCP79412::AlarmBlock()) == 0); //Explicit alarm cancels it
+	CHECK(Rtc2.rearmRecurring() == -1);
+
+	FlakyBus Flaky3; //Same for the re-arm done by serviceAlarms()
+	MCP79412 Rtc3(Flaky3);
+	setClock(Rtc3, MCP79412::toUnix({2024, 5, 1, 3, 10, 0, 0}));
+	CHECK(Rtc3.setRecurringAlarm(60) == 0);
+	MCP79412::AlarmInfo Before;
+	MCP79412::AlarmInfo After;
+	Rtc3.getAlarm(0, Before);
+	setClock(Rtc3, Before.next);
+	Flaky3.rtc[MCP79412Regs::Alarm<0>::WKDAY] |= MCP79412Regs::ALMIF;
+	Rtc3.handleInterrupt();
+	Flaky3.failWrites = 1;
+	CHECK(Rtc3.serviceAlarms() == -2);
+	CHECK(Rtc3.alarmPending());
+	CHECK(Rtc3.serviceAlarms() == 1); //Full block write, recurrence kept
+	Rtc3.getAlarm(0, After);
+	CHECK(!After.flag && After.next == Before.next + 60);
+	CHECK(recurringWake(Flaky3, Rtc3) == 3);
+}
+
+struct TimerLog {
+	uint8_t ids[16];
+	uint8_t count;
+};
+
+static void logTimer(uint8_t Id, void *Context)
+{
+	TimerLog *Log = (TimerLog*)Context;
+	if(Log->count < sizeof(Log->ids)) Log->ids[Log->count++] = Id;
+}
+
+/**
+ * Advance the clock to the next scheduled deadline and let ALM0 fire
+ *
+ * @return int, return of serviceAlarms()
+ */
+static int schedulerWake(MCP79412MemoryBus &Mem, MCP79412 &Rtc, time_t Next)
+{
+	MCP79412::AlarmInfo Info;
+	Rtc.getAlarm(0, Info);
+	CHECK(Info.enabled && Info.next == Next); //Nearest deadline is what the device holds
+	setClock(Rtc, Next);
+	Mem.rtc[MCP79412Regs::Alarm<0>::WKDAY] |= MCP79412Regs::ALMIF;
+	Rtc.handleInterrupt();
+	return Rtc.serviceAlarms();
+}
+
+/**
+ * Two periodic timers and a one-shot multiplexed on ALM0, through several wakes, then a reset which restores them
+ * from SRAM and catches up on what came due while asleep (user-017)
+ */
+static void checkScheduler()
+{
+	const time_t Midnight = MCP79412::toUnix({2024, 6, 1, 6, 0, 0, 0});
+	const int Offset = 0x08;
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	setClock(Rtc, Midnight + 1);
+	TimerLog Log = {};
+	MCP79412Scheduler<4> Sched(Rtc);
+	CHECK(Sched.every(0, 600, 0, logTimer, &Log) == 0);
+	CHECK(Sched.every(1, 900, 0, logTimer, &Log) == 0);
+	CHECK(Sched.at(2, Midnight + 1200, logTimer, &Log) == 0);
+	CHECK(Sched.begin(Offset) == 0);
+	CHECK(Log.count == 0 && Sched.size() == 3 && Sched.next() == Midnight + 600);
+
+	CHECK(schedulerWake(Mem, Rtc, Midnight + 600) == 1);
+	CHECK(Log.count == 1 && Log.ids[0] == 0 && Sched.next() == Midnight + 900);
+	CHECK(schedulerWake(Mem, Rtc, Midnight + 900) == 1);
+	CHECK(Log.count == 2 && Log.ids[1] == 1 && Sched.next() == Midnight + 1200);
+	CHECK(schedulerWake(Mem, Rtc, Midnight + 1200) == 1); //Periodic and one-shot due together, one wake runs both
+	CHECK(Log.count == 4 && Log.ids[2] + Log.ids[3] == 0 + 2 && Log.ids[2] != Log.ids[3]);
+	CHECK(Sched.size() == 2 && Sched.next() == Midnight + 1800); //One-shot retired
+	CHECK(schedulerWake(Mem, Rtc, Midnight + 1800) == 1);
+	CHECK(Log.count == 6 && Log.ids[4] + Log.ids[5] == 0 + 1 && Log.ids[4] != Log.ids[5]);
+	CHECK(Sched.next() == Midnight + 2400);
+	CHECK(schedulerWake(Mem, Rtc, Midnight + 2400) == 1);
+	CHECK(Log.count == 7 && Log.ids[6] == 0 && Sched.next() == Midnight + 2700);
+
+	//Reset while asleep, timer 0 missed 3000 and timer 1 missed 2700, each runs once on begin() then realigns
+	setClock(Rtc, Midnight + 3100);
+	MCP79412 Reset(Mem);
+	TimerLog After = {};
+	MCP79412Scheduler<4> Restored(Reset);
+	CHECK(Restored.bind(0, logTimer, &After) == 0);
+	CHECK(Restored.bind(1, logTimer, &After) == 0);
+	CHECK(Restored.begin(Offset, Midnight + 2401) == 0);
+	CHECK(After.count == 2 && After.ids[0] + After.ids[1] == 0 + 1 && After.ids[0] != After.ids[1]);
+	CHECK(Restored.size() == 2 && Restored.next() == Midnight + 3600); //One-shot was not restored
+	CHECK(schedulerWake(Mem, Reset, Midnight + 3600) == 1);
+	CHECK(After.count == 4);
+	CHECK(Restored.next() == Midnight + 4200);
+}
+
+/**
+ * Take the bus a number of times, holding it for about a millisecond each time as a long burst would
+ */
+static void holdBus(MCP79412Bus &Bus, int Count)
+{
+	for(int i = 0; i < Count; i++) {
+		MCP79412Bus::Guard Lock(Bus);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/**
+ * Without try-lock a lock is counted as contended when it waited CONTENDED_WAIT_US, which only happens when another 
+ * thread held the bus (user-015)
+ */
+static void checkLockContention()
+{
+	const int Count = 200;
+	BlockingBus Single;
+	holdBus(Single, Count);
+	CHECK(Single.getStats().locks == Count);
+	CHECK(Single.getStats().lockContended <= Count/100); //Only a preempted micros() read can count here
+
+	BlockingBus Shared;
+	std::thread Other(holdBus, std::ref(Shared), Count);
+	holdBus(Shared, Count);
+	Other.join();
+	const MCP79412Bus::Stats &Stats = Shared.getStats();
+	CHECK(Stats.locks == 2*Count);
+	CHECK(Stats.lockContended > Single.getStats().lockContended + Count/100);
+	CHECK(Stats.lockWaitMaxUs >= MCP79412Bus::CONTENDED_WAIT_US);
+}
+
+/**
+ * Waiting for a seconds edge polls at ANCHOR_POLL_INTERVAL, the simulated clock never ticks so this is the full wait (user-005)
+ */
+static void checkAnchorWait()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	setClock(Rtc, MCP79412::toUnix({2024, 6, 1, 6, 12, 0, 0}));
+	Mem.resetStats();
+	uint32_t Start = millis();
+	CHECK(Rtc.syncAnchor(true) == 0);
+	CHECK(millis() - Start >= 1100);
+	CHECK(Mem.getStats().transactions <= 1100 + 4); //One read per ms, plus the reads around the wait
+}
+
+/**
+ * A flag left set keeps MFP asserted and no new edge comes, serviceAlarms() must keep the event pending (user-016)
+ */
+static void checkAlarmService()
+{
+	FlakyBus Flaky;
+	MCP79412 Rtc(Flaky);
+	setClock(Rtc, MCP79412::toUnix({2024, 5, 1, 3, 10, 0, 0}));
+	CHECK(Rtc.setAlarm(30, 0) == 0);
+	CHECK(Rtc.setAlarm(90, 1) == 0);
+	Flaky.rtc[MCP79412Regs::Alarm<0>::WKDAY] |= MCP79412Regs::ALMIF;
+	Rtc.handleInterrupt();
+	Flaky.failWrites = 1; //Clear is NACKed
+	CHECK(Rtc.serviceAlarms() == -2);
+	CHECK(Rtc.alarmPending());
+	CHECK(Rtc.serviceAlarms() == 1);
+	CHECK(!(Flaky.rtc[MCP79412Regs::Alarm<0>::WKDAY] & MCP79412Regs::ALMIF));
+	CHECK(!Rtc.alarmPending());
+
+	Flaky.rtc[MCP79412Regs::Alarm<0>::WKDAY] |= MCP79412Regs::ALMIF;
+	Rtc.handleInterrupt();
+	Flaky.raiseAfterWrite = MCP79412Regs::Alarm<1>::WKDAY; //ALM1 matches between the read and the clear
+	CHECK(Rtc.serviceAlarms() == 1);
+	CHECK(Rtc.alarmPending());
+	CHECK(Rtc.serviceAlarms() == 2);
+	CHECK(!Rtc.alarmPending());
+	CHECK(Rtc.serviceAlarms() == 0);
+}
+
+/**
+ * getValue() reuses its snapshot for a while, a write to any register it holds must not be hidden by it (user-009)
+ */
+static void checkSnapshot()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	Rtc.setTime(2023, 12, 31, 7, 23, 59, 0);
+	CHECK(Rtc.getValue(0) == 2023);
+	Rtc.setTime(2024, 6, 1, 6, 12, 0, 0); //Sync followed at once by a log
+	CHECK(Rtc.getValue(0) == 2024 && Rtc.getValue(1) == 6 && Rtc.getValue(3) == 12);
+
+	CHECK(Rtc.getValue(5) >= 0 && Rtc.getSnapshot().trim() == 0);
+	Rtc.setTrim(3);
+	CHECK(Rtc.getValue(5) >= 0 && Rtc.getSnapshot().trim() == 0x83);
+	Rtc.setAlarm(60, 1);
+	CHECK(Rtc.getValue(5) >= 0 && Rtc.getSnapshot().alarmEnabled(1));
+	Mem.rtc[MCP79412Regs::Alarm<1>::WKDAY] |= MCP79412Regs::ALMIF;
+	CHECK(Rtc.getValue(5) >= 0 && !Rtc.getSnapshot().alarmFlag(1)); //Not written by the driver, snapshot still current
+	Rtc.clearAlarm(1);
+	CHECK(Rtc.getValue(5) >= 0 && !Rtc.getSnapshot().alarmFlag(1) && !(Mem.rtc[MCP79412Regs::Alarm<1>::WKDAY] & MCP79412Regs::ALMIF));
+	Rtc.enableAlarm(false, 1);
+	CHECK(Rtc.getValue(5) >= 0 && !Rtc.getSnapshot().alarmEnabled(1));
+}
+
+/**
+ * Latch an outage as the device would, the stamps are BCD minutes, hours, date and weekday/month with no year
+ */
+static void latchOutage(MCP79412MemoryBus &Mem, const MCP79412::Timestamp &Down, const MCP79412::Timestamp &Up)
+{
+	const MCP79412::Timestamp *Stamps[2] = {&Down, &Up};
+	for(int i = 0; i < 2; i++) {
+		uint8_t *Raw = Mem.rtc + (i == 0 ? MCP79412Regs::PWRDN : MCP79412Regs::PWRUP);
+		Raw[0] = MCP79412Codec::toBCD(Stamps[i]->min);
+		Raw[1] = MCP79412Codec::toBCD(Stamps[i]->hour);
+		Raw[2] = MCP79412Codec::toBCD(Stamps[i]->mday);
+		Raw[3] = (uint8_t)(Stamps[i]->wday << 5) | MCP79412Codec::toBCD(Stamps[i]->month);
+	}
+	Mem.rtc[MCP79412Regs::RTCWKDAY] |= MCP79412Regs::PWRFAIL;
+}
+
+/**
+ * Outages which span Dec 31 to Jan 1 take their years from the clock, reading clears PWRFAIL and the stamps (user-022)
+ */
+static void checkOutage()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	MCP79412::Outage Out;
+	Rtc.begin();
+	setClock(Rtc, MCP79412::toUnix({2025, 1, 1, 3, 0, 10, 30}));
+	CHECK(Rtc.readOutage(Out) == 0 && !Out.valid); //No PWRFAIL, nothing to report
+
+	latchOutage(Mem, {0, 12, 31, 2, 23, 50, 0}, {0, 1, 1, 3, 0, 5, 0}); //Down last year, up this year
+	CHECK(Rtc.readOutage(Out, false) == 0 && Out.valid);
+	CHECK(Out.down == MCP79412::toUnix({2024, 12, 31, 2, 23, 50, 0}));
+	CHECK(Out.up == MCP79412::toUnix({2025, 1, 1, 3, 0, 5, 0}) && Out.duration == 900);
+	CHECK(Mem.rtc[MCP79412Regs::RTCWKDAY] & MCP79412Regs::PWRFAIL); //Left latched
+	CHECK(Rtc.readOutage(Out) == 0 && Out.valid && Out.duration == 900);
+	CHECK(!(Mem.rtc[MCP79412Regs::RTCWKDAY] & MCP79412Regs::PWRFAIL));
+	bool Cleared = true;
+	for(int i = MCP79412Regs::PWRDN; i < MCP79412Regs::SRAM; i++) Cleared = Cleared && Mem.rtc[i] == 0;
+	CHECK(Cleared);
+	CHECK(Mem.rtc[MCP79412Regs::RTCWKDAY] & MCP79412Regs::VBATEN); //Rest of the register untouched
+	CHECK(Rtc.readOutage(Out) == 0 && !Out.valid);
+
+	latchOutage(Mem, {0, 12, 30, 1, 22, 0, 0}, {0, 12, 31, 2, 23, 59, 0}); //Whole outage last year
+	CHECK(Rtc.readOutage(Out) == 0 && Out.valid);
+	CHECK(Out.down == MCP79412::toUnix({2024, 12, 30, 1, 22, 0, 0}) && Out.up == MCP79412::toUnix({2024, 12, 31, 2, 23, 59, 0}));
+
+	latchOutage(Mem, {0, 2, 10, 6, 8, 0, 0}, {0, 12, 31, 2, 12, 0, 0}); //Down in February, before the up stamp's year turned
+	CHECK(Rtc.readOutage(Out) == 0 && Out.valid);
+	CHECK(Out.down == MCP79412::toUnix({2024, 2, 10, 6, 8, 0, 0}) && Out.up == MCP79412::toUnix({2024, 12, 31, 2, 12, 0, 0}));
+}
+
+/**
+ * Write a journal record straight into the simulated EEPROM, as left by an earlier session
+ */
+static void putRecord(MCP79412MemoryBus &Mem, uint8_t Addr, uint16_t Seq, uint8_t Type, uint32_t Value)
+{
+	uint8_t *Rec = Mem.eeprom + Addr;
+	const uint8_t Image[MCP79412::EEPROM_PAGE - 1] = {(uint8_t)Seq, (uint8_t)(Seq >> 8), Type, 
+		(uint8_t)Value, (uint8_t)(Value >> 8), (uint8_t)(Value >> 16), (uint8_t)(Value >> 24)};
+	memcpy(Rec, Image, sizeof(Image));
+	Rec[MCP79412::EEPROM_PAGE - 1] = MCP79412::crc8(Rec, MCP79412::EEPROM_PAGE - 1);
+}
+
+/**
+ * Journal appended past a lap, recovered by a new instance, across a sequence wrap and when full (user-012)
+ */
+static void checkJournal()
+{
+	const uint8_t Start = 0x40;
+	const uint8_t Page = MCP79412::EEPROM_PAGE;
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	uint32_t Value = 0;
+	CHECK(Rtc.enableJournal(Start, 4) == 0 && Rtc.recoverJournal() == 0);
+	CHECK(Rtc.readJournal(1, Value) == -2);
+	CHECK(Rtc.appendJournal(2, 200) == 0); //Only copy of type 2, must survive the laps below
+	for(uint32_t i = 1; i <= 10; i++) CHECK(Rtc.appendJournal(1, i) == 0);
+	CHECK(Rtc.readJournal(1, Value) == 0 && Value == 10);
+	CHECK(Rtc.readJournal(2, Value) == 0 && Value == 200); //Carried forward ahead of the head
+	CHECK(Rtc.appendJournal(0xFF, 0) == -1);
+
+	MCP79412 Reset(Mem); //Recovery finds the newest record and continues after it
+	CHECK(Reset.enableJournal(Start, 4) == 0 && Reset.recoverJournal() == 0);
+	CHECK(Reset.readJournal(1, Value) == 0 && Value == 10);
+	CHECK(Reset.readJournal(2, Value) == 0 && Value == 200);
+	CHECK(Reset.appendJournal(1, 11) == 0);
+	MCP79412 Again(Mem);
+	CHECK(Again.enableJournal(Start, 4) == 0 && Again.recoverJournal() == 0);
+	CHECK(Again.readJournal(1, Value) == 0 && Value == 11);
+
+	//Sequence wrapped in the last lap, 0x0001 is newer than 0xFFFF
+	putRecord(Mem, Start + 2*Page, 0xFFFE, 3, 30);
+	putRecord(Mem, Start + 3*Page, 0xFFFF, 3, 31);
+	putRecord(Mem, Start + 0*Page, 0x0000, 3, 32);
+	putRecord(Mem, Start + 1*Page, 0x0001, 3, 33);
+	MCP79412 Wrapped(Mem);
+	CHECK(Wrapped.enableJournal(Start, 4) == 0 && Wrapped.recoverJournal() == 0);
+	CHECK(Wrapped.readJournal(3, Value) == 0 && Value == 33);
+	CHECK(Wrapped.appendJournal(3, 34) == 0);
+	CHECK(Mem.eeprom[Start + 2*Page] == 0x02 && Mem.eeprom[Start + 2*Page + 1] == 0x00); //Next slot, next sequence
+	Mem.eeprom[Start + 2*Page + 3] ^= 0x01; //Torn newest record, the one before it is used
+	MCP79412 Torn(Mem);
+	CHECK(Torn.enableJournal(Start, 4) == 0 && Torn.recoverJournal() == 0);
+	CHECK(Torn.readJournal(3, Value) == 0 && Value == 33);
+
+	MCP79412MemoryBus Fresh; //Once every slot holds a different type nothing can be written
+	MCP79412 Full(Fresh);
+	CHECK(Full.enableJournal(Start, 4) == 0 && Full.recoverJournal() == 0);
+	for(uint8_t Type = 1; Type <= 4; Type++) CHECK(Full.appendJournal(Type, Type) == 0);
+	uint8_t Before[4*Page];
+	memcpy(Before, Fresh.eeprom + Start, sizeof(Before));
+	CHECK(Full.appendJournal(5, 5) == -2);
+	CHECK(memcmp(Before, Fresh.eeprom + Start, sizeof(Before)) == 0);
+	CHECK(Full.appendJournal(1, 10) == 0); //New value of a held type still fits
+	CHECK(Full.readJournal(1, Value) == 0 && Value == 10);
+	for(uint8_t Type = 2; Type <= 4; Type++) CHECK(Full.readJournal(Type, Value) == 0 && Value == Type);
+}
+
+static void checkTrim()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	CHECK(Rtc.enableJournal(0, 4) == 0);
+	Rtc.begin();
+	int8_t Steps = 0;
+	CHECK(Rtc.setTrim(-5) == 0 && Mem.rtc[MCP79412Regs::OSCTRIM] == 0x05);
+	CHECK(Rtc.setTrim(10) == 0 && Mem.rtc[MCP79412Regs::OSCTRIM] == 0x8A);
+	CHECK(Rtc.getTrim(Steps) == 0 && Steps == 10);
+	uint8_t Journal[32];
+	memcpy(Journal, Mem.eeprom, sizeof(Journal));
+	CHECK(Rtc.setTrim(10) == 0 && memcmp(Journal, Mem.eeprom, sizeof(Journal)) == 0); //Unchanged trim is not journaled again
+
+	//RTC 12 ppm fast, daily syncs with +-250 ms of noise, clock set to the reference after the second point
+	const int64_t Ref0 = 1700000000000LL;
+	const double Ppm = 12;
+	double Set = 0;
+	float Estimate = 0;
+	for(int d = 0; d < 8; d++) {
+		if(d == 5) CHECK(Rtc.calibrateTrim() == -1); //Points only span 4 days, default needs a week
+		int64_t Ref = Ref0 + d*86400000LL;
+		double Offset = Ppm*1e-6*d*86400000.0 + (d % 2 ? 250 : -250) - Set;
+		Rtc.addCalibrationPoint(Ref + (int64_t)Offset, Ref);
+		if(d == 1) {
+			Set = Offset + Set; //Offset removed by setTime()
+			Rtc.setTime(2024, 1, 1, 0, 0, 0);
+		}
+	}
+	CHECK(Rtc.estimateDrift(Estimate) == 0 && fabs(Estimate - Ppm) < 1);
+	CHECK(Rtc.calibrateTrim(8*86400) == -1); //Points only span 7 days
+	CHECK(Rtc.calibrateTrim() == 0);
+	CHECK(Rtc.getTrim(Steps) == 0 && Steps == (int8_t)lround(10 - Estimate/MCP79412::TRIM_PPM_PER_STEP)); //Fast clock, clocks removed
+	CHECK(Rtc.estimateDrift(Estimate) == -1); //Points cleared with the old trim
+
+	Mem.rtc[MCP79412Regs::OSCTRIM] = 0; //Total power loss clears OSCTRIM and VBATEN
+	Mem.rtc[MCP79412Regs::RTCWKDAY] &= ~MCP79412Regs::VBATEN;
+	MCP79412 Restored(Mem);
+	Restored.enableJournal(0, 4);
+	Restored.begin();
+	CHECK(Restored.getTrim(Steps) == 0 && Steps == (int8_t)lround(10 - Estimate/MCP79412::TRIM_PPM_PER_STEP));
+
+	Mem.rtc[MCP79412Regs::OSCTRIM] = 0x85;
+	MCP79412 Plain(Mem);
+	Plain.begin();
+	CHECK(Mem.rtc[MCP79412Regs::OSCTRIM] == 0x85); //begin() leaves the trim alone
+}
+
+/**
+ * Run the same alarm sequence through the bool API and through alarm<N>(), device and traffic must match (user-024)
+ */
+/**
+ * Reaches into the error queue to leave a slot reserved but not yet published, as an ISR interrupted part way
+ * through throwError() would
+ */
+struct MCP79412Check {
+	static void reserveError(MCP79412 &Rtc)
+	{
+		Rtc.errorHead.store((Rtc.errorHead.load() + 1) % MCP79412::ERROR_INDEX_WRAP);
+	}
+	static void publishError(MCP79412 &Rtc, uint32_t Code)
+	{
+		MCP79412::ErrorSlot &Slot = Rtc.errorQueue[(Rtc.errorHead.load() + MCP79412::ERROR_INDEX_WRAP - 1) % MCP79412::ERROR_QUEUE_SIZE];
+		Slot.code = Code;
+		Slot.count.store(1);
+	}
+};
+
+static void countError(const MCP79412::ErrorRecord &Record, void *Context)
+{
+	MCP79412::ErrorRecord *Out = (MCP79412::ErrorRecord*)Context;
+	*Out = Record;
+}
+
+static void checkErrors()
+{
+	MCP79412MemoryBus Mem;
+	MCP79412 Rtc(Mem);
+	uint32_t Codes[MCP79412_MAX_ERRORS];
+
+	//Repeats coalesce into the slot of the first occurrence
+	CHECK(Rtc.throwError(0x100) == 1);
+	CHECK(Rtc.throwError(0x200) == 2);
+	CHECK(Rtc.throwError(0x100) == 2);
+	CHECK(Rtc.throwError(0x100) == 2);
+	MCP79412::ErrorRecord Record = {};
+	CHECK(Rtc.drainErrors(countError, &Record) == 2);
+	CHECK(Record.code == 0x200 && Record.count == 1); //Last visited is the newest
+	CHECK(Rtc.drainErrors(NULL) == 0);
+
+	//Full queue keeps the oldest codes, drops new ones but still counts repeats of queued ones
+	for(uint32_t i = 0; i < MCP79412_MAX_ERRORS + 3; i++) Rtc.throwError(0x1000 + i);
+	CHECK(Rtc.throwError(0x1000) == MCP79412_MAX_ERRORS);
+	CHECK(Rtc.getErrorsArray(Codes) == MCP79412_MAX_ERRORS + 3); //Distinct codes plus dropped
+	CHECK(Codes[0] == 0x1000 && Codes[MCP79412_MAX_ERRORS - 1] == 0x1000 + MCP79412_MAX_ERRORS - 1);
+	CHECK(Rtc.getErrorsArray(Codes) == 0); //Queue and dropped count were both cleared
+	CHECK(Rtc.takeDroppedErrors() == 0);
+
+	//Drain stops at a slot which is reserved but not yet filled, and collects it once published
+	Rtc.throwError(0x300);
+	MCP79412Check::reserveError(Rtc);
+	CHECK(Rtc.throwError(0x300) == 2); //Coalesces into the published slot, not the pending one
+	CHECK(Rtc.drainErrors(countError, &Record) == 1 && Record.code == 0x300 && Record.count == 2);
+	CHECK(Rtc.drainErrors(NULL) == 0);
+	MCP79412Check::publishError(Rtc, 0x400);
+	CHECK(Rtc.drainErrors(countError, &Record) == 1 && Record.code == 0x400);
+
+	//SRAM copy survives a reset, errors from before it queue behind those thrown since
+	const uint8_t Offset = 0x10;
+	CHECK(Rtc.enableSramErrorLog(Offset, 4) == 0);
+	Rtc.throwError(0x500);
+	Rtc.throwError(0x600);
+	CHECK(Mem.rtc[MCP79412Regs::SRAM + Offset + 1] == 2);
+	MCP79412 Reset(Mem);
+	Reset.throwError(0x700);
+	Reset.throwError(0x600);
+	CHECK(Reset.enableSramErrorLog(Offset, 4) == 0);
+	CHECK(Reset.getErrorsArray(Codes) == 3 && Codes[0] == 0x700 && Codes[1] == 0x600 && Codes[2] == 0x500);
+	CHECK(Mem.rtc[MCP79412Regs::SRAM + Offset + 1] == 0); //Drain clears the copy
+	MCP79412 Again(Mem);
+	CHECK(Again.enableSramErrorLog(Offset, 4) == 0 && Again.getErrorsArray(Codes) == 0);
+	Mem.rtc[MCP79412Regs::SRAM + Offset + 3] ^= 0x01; //Corrupt copy is ignored
+	Mem.rtc[MCP79412Regs::SRAM + Offset + 1] = 1;
+	MCP79412 Corrupt(Mem);
+	CHECK(Corrupt.enableSramErrorLog(Offset, 4) == 0 && Corrupt.getErrorsArray(Codes) == 0);
+	CHECK(Rtc.enableSramErrorLog(0x3F, 4) == -1); //Does not fit in SRAM
+}
+
+template <uint8_t N>
+static void checkAlarmHandle()
+{
+	MCP79412MemoryBus MemA;
+	MCP79412MemoryBus MemB;
+	MCP79412 A(MemA);
+	MCP79412 B(MemB);
+	setClock(A, MCP79412::toUnix({2024, 7, 15, 1, 8, 30, 0}));
+	setClock(B, MCP79412::toUnix({2024, 7, 15, 1, 8, 30, 0}));
+	MemA.resetStats();
+	MemB.resetStats();
+
+	MCP79412::AlarmBlock Block;
+	Block.time(9, 0, 0).match(MCP79412::AlarmMask::Hours);
+	int ResultA[6];
+	int ResultB[6];
+	ResultA[0] = A.commitAlarm(Block, N);
+	ResultB[0] = B.alarm<N>().commit(Block);
+	Block.time(10, 15, 0).match(MCP79412::AlarmMask::Minutes);
+	ResultA[1] = A.rearmAlarm(Block, N);
+	ResultB[1] = B.alarm<N>().rearm(Block);
+	MemA.rtc[MCP79412Regs::Alarm<N>::WKDAY] |= MCP79412Regs::ALMIF;
+	MemB.rtc[MCP79412Regs::Alarm<N>::WKDAY] |= MCP79412Regs::ALMIF;
+	ResultA[2] = A.readAlarm(N);
+	ResultB[2] = B.alarm<N>().flag();
+	ResultA[3] = A.clearAlarm(N);
+	ResultB[3] = B.alarm<N>().clear();
+	ResultA[4] = A.enableAlarm(false, N);
+	ResultB[4] = B.alarm<N>().enable(false);
+	ResultA[5] = A.setAlarm(90, N);
+	ResultB[5] = B.alarm<N>().in(90);
+
+	CHECK(memcmp(ResultA, ResultB, sizeof(ResultA)) == 0);
+	CHECK(ResultA[2] == 1);
+	CHECK(memcmp(MemA.rtc, MemB.rtc, sizeof(MemA.rtc)) == 0);
+	CHECK(MemA.getStats().transactions == MemB.getStats().transactions);
+	CHECK(MemA.getStats().bytesWritten == MemB.getStats().bytesWritten);
+	CHECK(MemA.rtc[MCP79412Regs::CONTROL] & MCP79412Regs::Alarm<N>::EN);
+}
+
+int main()
+{
+	checkCalendar();
+	checkRecurring();
+	checkAlarmService();
+	checkScheduler();
+	checkAnchorWait();
+	checkSnapshot();
+	checkOutage();
+	checkJournal();
+	checkTrim();
+	checkErrors();
+	checkAlarmHandle<0>();
+	checkAlarmHandle<1>();
+	checkLockContention();
+	if(Failures == 0) printf("All checks passed\n");
+	return Failures;
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+size_report.cpp
+Host report of the RAM used by each driver object, for the build configuration it is compiled with
+Bobby Schulz @ GEMS Sensing
+
+Built and run by `make size`, which compiles it once per configuration with MCP79412_RAM_BUDGET set, so an
+instance which outgrows its budget fails the build rather than showing up in this report. The sizes are for the
+host ABI (LP64 on a 64 bit PC), pointers make up a larger share of the instance here than on a 32 bit MCU
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#include "MCP79412.h"
+#include "MCP79412_Scheduler.h"
+#include <stdio.h>
+
+int main()
+{
+	#if defined(MCP79412_LEAN)
+	const char *Config = "lean";
+	#else
+	const char *Config = "full";
+	#endif
+	printf("%s, MCP79412_MAX_ERRORS = %d\n", Config, MCP79412_MAX_ERRORS);
+	printf("  sizeof(MCP79412)              %4zu\n", sizeof(MCP79412));
+	printf("  sizeof(MCP79412MemoryBus)     %4zu\n", sizeof(MCP79412MemoryBus));
+	printf("  sizeof(MCP79412Mux)           %4zu\n", sizeof(MCP79412Mux));
+	printf("  sizeof(MCP79412Scheduler<4>)  %4zu\n", sizeof(MCP79412Scheduler<4>));
+	return 0;
+}
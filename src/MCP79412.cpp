@@ -17,47 +17,105 @@ Distributed as-is; no warranty is given.
 
 // #include "Arduino.h"
 #include "MCP79412.h"
-#include <Wire.h>
+#include "MCP79412_Codec.h"
+#include <string.h>
 
-enum Regs : uint8_t //Define time write/read registers
+const uint8_t CacheRegs[] = {MCP79412Regs::CONTROL, MCP79412Regs::OSCTRIM, MCP79412Regs::Alarm<0>::WKDAY, MCP79412Regs::Alarm<1>::WKDAY};
+const uint8_t CacheMask[] = {0xFF, 0xFF, (uint8_t)~MCP79412Regs::ALMIF, (uint8_t)~MCP79412Regs::ALMIF}; //Bits owned by software, ALMxIF is set by hardware so is never cached
+
+// #define RETRO_ON_MANUAL //Debug include 
+
+using namespace MCP79412Codec;
+
+/**
+ * Helper function, decodes a burst read of the time registers (0x00~0x06)
+ *
+ * @param Raw, the 7 register values 
+ * @return Timestamp, the decoded time
+ */
+static inline MCP79412::Timestamp decodeTime(const uint8_t *Raw)
+{
+	MCP79412::Timestamp ts;
+	ts.sec = fromBCD(Raw[MCP79412Regs::RTCSEC], SEC_MASK);
+	ts.min = fromBCD(Raw[MCP79412Regs::RTCMIN], MIN_MASK);
+	ts.hour = fromBCD(Raw[MCP79412Regs::RTCHOUR], HOUR_MASK); //24-hour time
+	ts.wday = Raw[MCP79412Regs::RTCWKDAY] & WDAY_MASK;
+	ts.mday = fromBCD(Raw[MCP79412Regs::RTCDATE], DATE_MASK);
+	ts.month = fromBCD(Raw[MCP79412Regs::RTCMTH], MONTH_MASK);
+	ts.year = (uint16_t)(fromBCD(Raw[MCP79412Regs::RTCYEAR]) + 2000);
+	return ts;
+}
+
+/**
+ * Register image of an alarm block (seconds, minutes, hours, weekday, date, month), ALMxIF left clear
+ */
+static void encodeAlarm(const MCP79412::AlarmBlock &Block, uint8_t Polarity, uint8_t *Image)
 {
-	Seconds = 0x00,
-	Minutes = 0x01,
-	Hours = 0x02,
-	WeekDay = 0x03,
-	Date = 0x04,
-	Month = 0x05,
-	Year = 0x06,
-};
+	Image[MCP79412Regs::ALMSEC] = toBCD(Block.sec);
+	Image[MCP79412Regs::ALMMIN] = toBCD(Block.min);
+	Image[MCP79412Regs::ALMHOUR] = toBCD(Block.hour); //24 hour mode
+	Image[MCP79412Regs::ALMWKDAY] = (uint8_t)(Polarity | ((uint8_t)Block.mask << MCP79412Regs::ALMMSK_POS) | (Block.wday & WDAY_MASK));
+	Image[MCP79412Regs::ALMDATE] = toBCD(Block.mday);
+	Image[MCP79412Regs::ALMMTH] = toBCD(Block.month);
+}
 
-const uint8_t AlarmOffset = 0x07; //Offset between ALM0 and ALM1 regs
-const uint8_t BlockOffset = 0x0A; //Offset from time regs to ALM regs
 
-// #define RETRO_ON_MANUAL //Debug include 
+#if defined(MCP79412_HAS_WIRE)
+/**
+ * Returns the transport shared by all instances created without an explicit bus
+ */
+static MCP79412Bus& defaultBus()
+{
+	static MCP79412WireBus WireBus(Wire);
+	return WireBus;
+}
+
+MCP79412::MCP79412() : bus(&defaultBus())
+{
+
+}
+#endif
+
+MCP79412::MCP79412(MCP79412Bus &Bus) : bus(&Bus)
+{
 
+}
 
-MCP79412::MCP79412()
+MCP79412::MCP79412(MCP79412Mux &Mux, uint8_t Channel) : bus(&Mux.channel(Channel))
 {
 
 }
 
 /**
- * Initializes the system, starts up I2C and turns on the oscilator and sets up to use battery backup 
+ * Initializes the system, starts up I2C and turns on the oscilator and sets up to use battery backup. Returns as soon 
+ * as the oscilator is seen running (immediately if it kept running on VBAT), waits at most OSC_BEGIN_WAIT
  *
  * @return the I2C status value (if any error occours) or if oscilator does not start properly 
  */
 int MCP79412::begin(bool UseExtOsc)
 {
-	#if defined(ARDUINO) && ARDUINO >= 100 
-		Wire.begin();
-	#elif defined(PARTICLE)
-		if(!Wire.isEnabled()) Wire.begin(); //Only initialize I2C if not done already //INCLUDE FOR USE WITH PARTICLE 
-	#endif
+	beginAsync(UseExtOsc, OSC_BEGIN_WAIT);
+	AsyncStatus Status = AsyncStatus::Busy;
+	while((Status = pollBegin()) == AsyncStatus::Busy) delay(1);
+	return Status == AsyncStatus::Done; //Return oscilator status
+}
+
+/**
+ * Non-blocking version of begin(). Does the register setup and sets the oscilator running, then returns without 
+ * waiting for it to start. Call pollBegin() until it reports Done or Failed, other initialization can run meanwhile
+ *
+ * @param UseExtOsc, use an external oscilator input rather than the crystal
+ * @param Timeout, time allowed for the oscilator to start [ms]
+ * @return int, the I2C status value of starting the oscilator
+ */
+int MCP79412::beginAsync(bool UseExtOsc, uint32_t Timeout)
+{
+	bus->begin(); //Bring up the transport (only initializes I2C if not done already)
 
 	Timestamp initTime = getRawTime();
-    if(initTime.year < 2022) throwError(ANCIENT_TIME);
+    if(initTime.year < 2022) logError(ANCIENT_TIME);
     if(initTime.year == 2000 || initTime.month == 0 || initTime.mday == 0) {
-        throwError(NONREAL_TIME); 
+        logError(NONREAL_TIME); 
         setTime(2001, 1, 1, 0, 0, 0); //If the current time is less than 00:00:00 2000/1/1 (if month/day is set to zero in correctly), set time to default time so alarms work 
     }
 	
@@ -65,32 +123,56 @@ int MCP79412::begin(bool UseExtOsc)
 	// Wire.write(0x0E); //Write values to Control reg
 	// Wire.write(0x24); //Start oscilator, turn off BBSQW, Turn off alarms, turn on convert
 	// return Wire.endTransmission(); //return result of begin, reading is optional
-	if(readBit(Regs::WeekDay, 3) == 0) throwError(RTC_POWER_LOSS); //If this bit is set back to 0, all power to the RTC must have been lost
-	setBit(Regs::WeekDay, 3); //Turn backup battery enable
+	#if !defined(MCP79412_LEAN)
+	if(journalSlots > 0) recoverJournal(); //Find newest records in EEPROM journal
+	#endif
+	bool PowerLoss = (readByte(MCP79412Regs::RTCWKDAY) & MCP79412Regs::VBATEN) == 0;
+	if(PowerLoss) logError(RTC_POWER_LOSS); //If this bit is set back to 0, all power to the RTC must have been lost
+	updateBits(MCP79412Regs::RTCWKDAY, 0, MCP79412Regs::VBATEN); //Turn backup battery enable
+
+	#if !defined(MCP79412_LEAN)
+	alarmArmed = 0; //Alarms are disabled by clearing CONTROL
+	#endif
+	stopRecurrence(0);
+	stopRecurrence(1);
+	writeByte(MCP79412Regs::CONTROL, 0x00); //Clear control reg //DEBUG! Prevent issue where square wave is erroniously enabled on multi-purpose pin
+	#if !defined(MCP79412_LEAN)
+	uint32_t Trim = 0;
+	if(PowerLoss && readJournal(JOURNAL_TYPE_TRIM, Trim) == 0) writeByte(MCP79412Regs::OSCTRIM, Trim); //OSCTRIM was lost with VBAT, restore calibration
+	#endif
 
-	writeByte(Control, 0x00); //Clear control reg //DEBUG! Prevent issue where square wave is erroniously enabled on multi-purpose pin
-	writeByte(Control + 1, 0x00); //Clear trim register //DEBUG! Prevent where trim value is erroniously set
+	oscStarted = millis();
+	oscPolled = oscStarted - OSC_POLL_INTERVAL; //First poll checks immediately
+	oscTimeout = Timeout;
 	if(!UseExtOsc) {
-		bool OscError = startOsc();
-		return OscError; //Return oscilator status
+		int Error = startOsc();
+		oscState = Error == 0 ? AsyncStatus::Busy : AsyncStatus::Failed;
+		return Error;
 	}
 	else {
-		clearBit(0, 7); //Clear bit 7 of reg 0 (turn off ST bit)
-		int Error = setBit(Control, 3); //Turn on external oscilator input
-		if(Error == 0) return 1; //Return pass if I2C comunication is good, FIX??
-		else return 0; //Return fail if any other I2C error code 
+		updateBits(MCP79412Regs::RTCSEC, MCP79412Regs::ST, 0); //Turn off ST bit
+		int Error = updateBits(MCP79412Regs::CONTROL, 0, MCP79412Regs::EXTOSC); //Turn on external oscilator input
+		oscState = Error == 0 ? AsyncStatus::Done : AsyncStatus::Failed; //Pass if I2C comunication is good, FIX??
+		return Error;
 	}
-	
-	// Serial.print("Oscillator State:"); //DEBUG!
-	// Serial.println(OscError); //DEBUG! 
-	// Serial.print("Reg Sates:"); //DEBUG!
-	// Serial.print(ReadByte(Control), HEX); //DEBUG!
-	// Serial.print(","); //DEBUG!
-	// // Serial.print(ReadByte(TimeRegs::Seconds), HEX); //DEBUG!
-	// Serial.print(ReadByte(0x0A), HEX); //DEBUG!
-	// Serial.print(","); //DEBUG!
-	// // Serial.println(ReadByte(TimeRegs::WeekDay), HEX); //DEBUG!
-	// Serial.println(ReadByte(0x0D), HEX); //DEBUG!
+}
+
+/**
+ * Advance a beginAsync(). Checks the OSCRUN bit (one single byte read, at most every OSC_POLL_INTERVAL)
+ *
+ * @return AsyncStatus, Busy while the oscilator is starting, Done once it is running, Failed if it did not start 
+ * within the timeout (or begin was not started)
+ */
+MCP79412::AsyncStatus MCP79412::pollBegin()
+{
+	if(oscState != AsyncStatus::Busy) return oscState;
+	uint32_t Now = millis();
+	if((Now - oscPolled) < OSC_POLL_INTERVAL) return AsyncStatus::Busy;
+	oscPolled = Now;
+	uint8_t WDay = 0;
+	if(bus->read(ADR, MCP79412Regs::RTCWKDAY, &WDay, 1) == 0 && (WDay & MCP79412Regs::OSCRUN)) oscState = AsyncStatus::Done;
+	else if((Now - oscStarted) > oscTimeout) oscState = AsyncStatus::Failed;
+	return oscState;
 }
 
 /**
@@ -107,49 +189,39 @@ int MCP79412::begin(bool UseExtOsc)
  */
 int MCP79412::setTime(int Year, int Month, int Day, int DoW, int Hour, int Min, int Sec)
 {
-	bool stVal = readBit(0x00, 7); //Read the ST value from the seconds register to check for the current value
-	int Error = 0; //Default to no error 
+	#if !defined(MCP79412_LEAN)
+	anchorValid = false; //Time anchor is no longer valid, force re-anchor on next use
+	if(calCount > 0) calBias = calPoints[(calHead + CAL_MAX_POINTS - 1) % CAL_MAX_POINTS].offset; //Assume time is set to the reference of the last point
+	#endif
+	invalidateSnapshot();
+	MCP79412Bus::Guard Lock(*bus); //Control bits must not change between read and write
+	uint8_t Current[4] = {0}; //Seconds (ST bit) through WeekDay (VBATEN and status bits), read in one burst
+	int Error = bus->read(ADR, MCP79412Regs::RTCSEC, Current, sizeof(Current));
+	if(Error != 0) return Error; //Do not write time with unknown control bits
+	bool stVal = Current[MCP79412Regs::RTCSEC] & MCP79412Regs::ST; //Check the current ST value from the seconds register
 	if(Year > 999) {
 		Year = Year - 2000; //FIX! Add compnesation for centry 
 	}
-	int TimeDate [7]={Sec,Min,Hour,DoW,Day,Month,Year};
-	for(int i=0; i<=6;i++){
-		if(i == 3) {
-			uint8_t DoW_Temp = readByte(Regs::WeekDay); //Read in current value
-			DoW_Temp = DoW_Temp & 0xF8; //Clear lower 3 bits (day of week portion of register)
-			DoW_Temp = DoW_Temp | (DoW & 0x07); //Set lower 3 bits from DoW input
-			TimeDate[i] = DoW_Temp; //Return value  
-		}
-		else { //Otherwise write method for other regs
-			int b = TimeDate[i]/10;
-			int a = TimeDate[i]-b*10;
-			// if(i == 2){
-			// 	if (b==2)
-			// 		b=B00000010;
-			// 	else if (b==1)
-			// 		b=B00000001;
-			// }	
-			TimeDate[i]= a+(b<<4);
-			if(i == 0 && stVal) TimeDate[i] = TimeDate[i] | 0x80; //Set ST bit to keep oscilator running if previously set
-
-			//FIX! Test for leap year and set LPYR bit
-		}
-		
-		#if defined(RETRO_ON_MANUAL)
+	uint8_t Image[7] = { //Register image for 0x00~0x06, committed as a single transaction
+		(uint8_t)(toBCD(Sec) | (stVal ? MCP79412Regs::ST : 0x00)), //Set ST bit to keep oscilator running if previously set
+		toBCD(Min),
+		toBCD(Hour), //24 hour mode
+		(uint8_t)((Current[MCP79412Regs::RTCWKDAY] & ~WDAY_MASK) | (DoW & WDAY_MASK)), //Keep status bits, set day of week portion of register
+		toBCD(Day),
+		toBCD(Month), //LPYR is read only, set by hardware
+		toBCD(Year)
+	};
+	#if defined(RETRO_ON_MANUAL)
+		for(int i = 0; i <= 6; i++) {
 			Serial.print(i);
 			Serial.print(":");
-			Serial.println(TimeDate[i], HEX);
-		#endif
-		int Val = writeByte(i, TimeDate[i]); //Grab error value
-		if(Val != 0) Error = Val; //Assign error value for any write error encountered 
-		// Wire.beginTransmission(ADR);
-		// Wire.write(i); //Write values starting at reg 0x00
-		// Wire.write(TimeDate[i]); //Write time date values into regs
-		// Wire.endTransmission(); //return result of begin, reading is optional
-  }
+			Serial.println(Image[i], HEX);
+		}
+	#endif
 
-  //Read back time to test result of write??
-  return Error; //Return write error value
+	//Write all time registers in one burst, device auto-increments so no rollover can occour between registers
+	//Read back time to test result of write??
+	return bus->write(ADR, MCP79412Regs::RTCSEC, Image, sizeof(Image)); //Return write error value
 }
 
 /**
@@ -170,61 +242,9 @@ int MCP79412::setTime(int Year, int Month, int Day, int Hour, int Min, int Sec)
 }
 
 MCP79412::Timestamp MCP79412::getRawTime() {
-	int TimeDate [7]; //second,minute,hour,weekday,monthday,month,year
-	Wire.beginTransmission(ADR); //Ask 1 byte of data
-	Wire.write(0x00); //Read values starting at reg 0x00
-	Wire.endTransmission();
-	Wire.requestFrom(ADR, 7);	//WAIT FOR DATA BACK FIX!!
-	Timestamp ts;
-
-	for(int i=0; i<=6;i++){
-		int n = Wire.read(); //Read value of reg
-
-		//Process results
-		int a=n & B00001111;
-		int high = (n >> 4) & B1111;
-		switch (i) {
-		case 0: // seconds
-			// break;
-		case 1: // minutes
-			a += (high & B0111) * 10;
-			break;
-		case 2: // hour (24-hour time)
-			// break;
-		case 4: // day of month
-			a += (high & B0011) * 10;
-			break;
-		case 3: // day of week
-			a &= B0111;
-			break;
-		case 5: // month of year
-			a += (high & B0001) * 10;
-			break;
-		default: // year
-			a += high * 10;
-			break;
-		}
-		TimeDate[i] = a;
-	}
-
-	ts.year = (uint16_t)(TimeDate[6] + 2000);
-	ts.month = (uint8_t)TimeDate[5];
-	ts.mday = (uint8_t)TimeDate[4];
-	ts.wday = (uint8_t)TimeDate[3];
-	ts.hour = (uint8_t)TimeDate[2];
-	ts.min = (uint8_t)TimeDate[1];
-	ts.sec = (uint8_t)TimeDate[0];
-
-	return ts;
-	// return {
-	// 	.year  = (uint16_t)(TimeDate[6] + 2000),
-	// 	.month = (uint8_t)TimeDate[5],
-	// 	.mday  = (uint8_t)TimeDate[4],
-	// 	.wday  = (uint8_t)TimeDate[3],
-	// 	.hour  = (uint8_t)TimeDate[2],
-	// 	.min   = (uint8_t)TimeDate[1],
-	// 	.sec   = (uint8_t)TimeDate[0]
-	// };
+	uint8_t Raw[7] = {0};
+	bus->read(ADR, MCP79412Regs::RTCSEC, Raw, sizeof(Raw)); //Read values starting at reg 0x00
+	return decodeTime(Raw);
 }
 
 /**
@@ -233,680 +253,1934 @@ MCP79412::Timestamp MCP79412::getRawTime() {
  * @param Mode, used to set which value is returned 
  * @return String of current time/date in the requested format 
  */
+#if defined(MCP79412_HAS_STRING)
 String MCP79412::getTime(Format mode)
 {
-	Timestamp t = getRawTime();
 	char str[32];
+	if(formatTime(str, sizeof(str), mode) < 0) return "Invalid Input";
+	return str;
+}
+#endif
 
-	Time_Date[5] = t.sec; //FIX!
-	Time_Date[4] = t.min;
-	Time_Date[3] = t.hour;
-	Time_Date[2] = t.mday;
-	Time_Date[1] = t.month;
-	Time_Date[0] = t.year;
+/**
+ * Format current time into a caller provided buffer, does not allocate 
+ *
+ * @param Buffer, destination for the null terminated string
+ * @param Len, size of the buffer (24 bytes is enough for any format)
+ * @param Mode, used to set which format is used
+ * @return int, number of characters written (not including null), -1 if the format is unknown or the buffer is too small
+ */
+int MCP79412::formatTime(char *Buffer, size_t Len, Format Mode)
+{
+	return formatTime(currentTime(), Buffer, Len, Mode);
+}
+
+/**
+ * Helper function, writes a zero padded decimal value 
+ *
+ * @param Str, where to write the digits
+ * @param Val, the value to write
+ * @param Width, the number of digits to write, 0 to use as many as required
+ * @return char*, position after the last digit written
+ */
+static char* putDigits(char *Str, uint32_t Val, uint8_t Width)
+{
+	if(Width == 0) { //Find minimum width
+		Width = 1;
+		for(uint32_t Div = 10; Val >= Div && Width < 10; Div *= 10) Width++;
+	}
+	for(int i = Width - 1; i >= 0; i--) {
+		Str[i] = '0' + (Val % 10);
+		Val = Val / 10;
+	}
+	return Str + Width;
+}
+
+/**
+ * Format a given time into a caller provided buffer, does not allocate 
+ *
+ * @param t, the time to format
+ * @param Buffer, destination for the null terminated string
+ * @param Len, size of the buffer (24 bytes is enough for any format)
+ * @param Mode, used to set which format is used
+ * @return int, number of characters written (not including null), -1 if the format is unknown or the buffer is too small
+ */
+int MCP79412::formatTime(const Timestamp &t, char *Buffer, size_t Len, Format Mode)
+{
+	char str[24];
+	char *p = str;
 	//Format raw results into appropriate string
-	switch (mode) {
-	case Format::Scientific: // Return in order Year, Month, Day, Hour, Minute, Second (Scientific Style)
-		sprintf(str, "%04d/%02d/%02d %02d:%02d:%02d", t.year, t.month, t.mday, t.hour, t.min, t.sec);
+	switch (Mode) {
+	case Format::Scientific: // Return in order Year, Month, Day, Hour, Minute, Second (Scientific Style), YYYY/MM/DD hh:mm:ss
+		p = putDigits(p, t.year, 4); *p++ = '/';
+		p = putDigits(p, t.month, 2); *p++ = '/';
+		p = putDigits(p, t.mday, 2); *p++ = ' ';
+		p = putDigits(p, t.hour, 2); *p++ = ':';
+		p = putDigits(p, t.min, 2); *p++ = ':';
+		p = putDigits(p, t.sec, 2);
 		break;
-	case Format::Civilian: // Return in order Month, Day, Year, Hour, Minute, Second (US Civilian Style)
-		sprintf(str, "%02d/%02d/%04d %02d:%02d:%02d", t.month, t.mday, t.year, t.hour, t.min, t.sec);
-		break;
-	case Format::US: { // Return in order Month, Day, Year, Hour (12 hour), Minute, Second
-			uint8_t twelveHour = t.hour % 12;
-			if (twelveHour == 0) twelveHour = 12;
-			sprintf(str, "%02d/%02d/%04d %02d:%02d:%02d %cM", t.month, t.mday, t.year, twelveHour, t.min, t.sec, t.hour >= 12 ? 'P' : 'A');
+	case Format::Civilian: // Return in order Month, Day, Year, Hour, Minute, Second (US Civilian Style), MM/DD/YYYY hh:mm:ss
+	case Format::US: { // Return in order Month, Day, Year, Hour (12 hour), Minute, Second, MM/DD/YYYY hh:mm:ss AM
+			uint8_t Hour = t.hour;
+			if(Mode == Format::US) {
+				Hour = t.hour % 12;
+				if (Hour == 0) Hour = 12;
+			}
+			p = putDigits(p, t.month, 2); *p++ = '/';
+			p = putDigits(p, t.mday, 2); *p++ = '/';
+			p = putDigits(p, t.year, 4); *p++ = ' ';
+			p = putDigits(p, Hour, 2); *p++ = ':';
+			p = putDigits(p, t.min, 2); *p++ = ':';
+			p = putDigits(p, t.sec, 2);
+			if(Mode == Format::US) {
+				*p++ = ' ';
+				*p++ = t.hour >= 12 ? 'P' : 'A';
+				*p++ = 'M';
+			}
 			break;
 		}
-	case Format::ISO_8601: // Return in ISO 8601 standard (UTC)
+	case Format::ISO_8601: // Return in ISO 8601 standard (UTC), YYYY-MM-DDThh:mm:ssZ
 		// FIX! Hard code for UTC time, allow for a fix??
-		sprintf(str, "%04d-%02d-%02dT%02d:%02d:%02dZ", t.year, t.month, t.mday, t.hour, t.min, t.sec);
+		p = putDigits(p, t.year, 4); *p++ = '-';
+		p = putDigits(p, t.month, 2); *p++ = '-';
+		p = putDigits(p, t.mday, 2); *p++ = 'T';
+		p = putDigits(p, t.hour, 2); *p++ = ':';
+		p = putDigits(p, t.min, 2); *p++ = ':';
+		p = putDigits(p, t.sec, 2); *p++ = 'Z';
 		break;
-	case Format::Stardate: { // Returns in order Year, Day (of year), Hour, Minute, Second (Stardate)
-			int DayOfYear = t.mday;
-			int MonthDay[13] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-			if (t.year % 4 == 0) MonthDay[2] = 29;
-			for(int m = 1; m < t.month; m++) {
-				DayOfYear += MonthDay[m];
-			}
-			sprintf(str, "%04d.%d %02d.%02d.%02d", t.year, DayOfYear, t.hour, t.min, t.sec);
+	case Format::Stardate: { // Returns in order Year, Day (of year), Hour, Minute, Second (Stardate), YYYY.D hh.mm.ss
+			int DayOfYear = dayOfYear(t.year, t.month, t.mday);
+			p = putDigits(p, t.year, 4); *p++ = '.';
+			p = putDigits(p, DayOfYear, 0); *p++ = ' ';
+			p = putDigits(p, t.hour, 2); *p++ = '.';
+			p = putDigits(p, t.min, 2); *p++ = '.';
+			p = putDigits(p, t.sec, 2);
 			break;
 		}
 	default:
-		return "Invalid Input";
+		return -1; //Unknown format
 	}
-	return str;
+	size_t n = p - str;
+	if(Buffer == NULL || Len < n + 1) return -1; //Does not fit with null terminator
+	memcpy(Buffer, str, n);
+	Buffer[n] = '\0';
+	return n;
 }
 
 /**
- * Return current time of the device, Unix time
+ * Return current time of the device, Unix time. If the time anchor is enabled this is interpolated from the 
+ * last anchor using millis() and only touches the bus when a re-anchor is due
  *
  * @return unsigned long of current Unix timestamp
  */
 time_t MCP79412::getTimeUnix()
 {
-	// Timestamp t = getRawTime(); //Get updated time
-	// struct tm timeinfo = {0}; //Create struct in C++ time land
-	// time_t rawtime;
-	// time ( &rawtime );
-	// timeinfo = *localtime ( &rawtime );
-	//Copy the time to C++ time land
-
-	int TimeDate [7] = {0,0,0,0,0,0,0}; //second,minute,hour,weekday,monthday,month,year
-	Wire.beginTransmission(ADR); //Ask 1 byte of data
-	Wire.write(0x00); //Read values starting at reg 0x00
-	Wire.endTransmission();
-	Wire.requestFrom(ADR, 7);	//WAIT FOR DATA BACK FIX!!
-	// Timestamp ts;
-
-	for(int i=0; i<=6;i++){
-		int n = Wire.read(); //Read value of reg
-
-		//Process results
-		int a=n & B00001111;
-		int high = (n >> 4) & B1111;
-		switch (i) {
-		case 0: // seconds
-			// break;
-		case 1: // minutes
-			a += (high & B0111) * 10;
-			break;
-		case 2: // hour (24-hour time)
-			// break;
-		case 4: // day of month
-			a += (high & B0011) * 10;
-			break;
-		case 3: // day of week
-			a &= B0111;
-			break;
-		case 5: // month of year
-			a += (high & B0001) * 10;
-			break;
-		default: // year
-			a += high * 10;
-			break;
+	#if !defined(MCP79412_LEAN)
+	if(anchorEnabled) return getTimeMillis()/1000; 
+	#endif
+	time_t Time = 0;
+	readClock(Time);
+	return Time;
+}
+
+/**
+ * Return current time in milliseconds since the Unix epoch. Without the time anchor this is a direct read and has 
+ * one second resolution. With the anchor the sub-second part is interpolated, and is only true to the RTC second 
+ * edge if the anchor was aligned (see syncAnchor)
+ *
+ * @return uint64_t, current Unix time [ms]
+ */
+uint64_t MCP79412::getTimeMillis()
+{
+	#if !defined(MCP79412_LEAN)
+	if(anchorEnabled) {
+		uint32_t Now = millis();
+		if(!anchorValid || (Now - anchorMillis) >= anchorActiveInterval) {
+			syncAnchor(false); //Re-anchor is due
+			Now = millis();
 		}
-		TimeDate[i] = a;
+		if(anchorValid) return (uint64_t)anchorTime*1000 + (Now - anchorMillis);
 	}
-	// timeinfo.tm_year = TimeDate[6] + 100; //Years since 1900, not 2000
-	// timeinfo.tm_mon = TimeDate[5] - 1; //Months since january
-	// timeinfo.tm_mday = TimeDate[4];
-	// timeinfo.tm_hour = TimeDate[2];
-	// timeinfo.tm_min = TimeDate[1];
-	// timeinfo.tm_sec = TimeDate[0];
-
-	// timeinfo.tm_year = t.year - 1900; //Years since 1900
-	// timeinfo.tm_mon = t.month - 1; //Months since january
-	// timeinfo.tm_mday = t.mday;
-	// timeinfo.tm_hour = t.hour;
-	// timeinfo.tm_min = t.min;
-	// timeinfo.tm_sec = t.sec;
-	// t.~Timestamp(); //Call destructor
-
-	// time_t rawTime = timegm(&timeinfo); //Convert struct to unix time
-	// return rawTime;
-	// return 0xDEADBEEF; //DEBUG!
-	return cstToUnix(TimeDate[6] + 2000, TimeDate[5], TimeDate[4], TimeDate[2], TimeDate[1], TimeDate[0]);
-	// return 0; //Return dummy value
+	#endif
+	time_t Time = 0;
+	readClock(Time); //Fall back to reading the device
+	return (uint64_t)Time*1000;
 }
 
+#if !defined(MCP79412_LEAN)
 /**
- * Return specific time date value to not be forced to parse string 
+ * Turns on the time anchor. The RTC is read once and tied to millis(), subsequent calls to getTimeUnix(), getTimeMillis() 
+ * and getTime() are interpolated with no I2C traffic until the next re-anchor. Each re-anchor measures the drift between 
+ * the MCU clock and the RTC, while the drift exceeds the limit the re-anchor period is halved (down to 1 second), 
+ * and is restored once the drift is back in range
  *
- * @param n, which value to be returned (0:Year, 1:Month, 2:Day, 3:Hour, 4:Minute, 5:Second)
- * @return int, the desired time date value in numerical form 
+ * @param Interval, maximum time between re-anchors [ms]
+ * @param DriftLimit, drift at re-anchor which causes the period to be shortened [ms], note drift is only resolved to 1 second unless anchors are aligned
+ * @return int, the I2C status value of the initial anchor
  */
-int MCP79412::getValue(int n)	// n = 0:Year, 1:Month, 2:Day, 3:Hour, 4:Minute, 5:Second
+int MCP79412::enableTimeAnchor(uint32_t Interval, uint32_t DriftLimit)
 {
-	getTime(MCP79412::Format::ISO_8601); //Update time
-	return Time_Date[n]; //Return desired value 
+	anchorEnabled = true;
+	anchorValid = false;
+	anchorInterval = Interval < 1000 ? 1000 : Interval;
+	anchorActiveInterval = anchorInterval;
+	anchorDriftLimit = DriftLimit;
+	anchorDrift = 0;
+	return syncAnchor(false);
 }
 
 /**
- * Setup the output mode of the system, using normal or inverted polarity. See page 27 of MCP79412 (Table 5-10 and Table 5-9)
- *
- * @param Val, which selects either Normal or Inverted polarity
- * @return int, the result of the I2C write 
+ * Turns off the time anchor, all time calls read the device directly
  */
-int MCP79412::setMode(Mode Val) 
+void MCP79412::disableTimeAnchor()
 {
-	if(Val == Mode::Normal) return clearBit(Regs::WeekDay + BlockOffset, 7); //Clear bit 7 of reg 0x0D (will be mirrored by hardware in reg 0x14)
-	if(Val == Mode::Inverted) return setBit(Regs::WeekDay + BlockOffset, 7); //Set bit 7 of reg 0x14 (will be mirrored by hardware in reg 0x14)
-	else return -1; //Return unknown input error 
+	anchorEnabled = false;
+	anchorValid = false;
 }
 
 /**
- * Set alarm for a given number of seconds from current time 
+ * Read the RTC and anchor it to millis(). If AlignToEdge is set, the seconds register is polled until it rolls over so 
+ * that the anchor lands on the second edge, this blocks for up to 1 second but gives ms accurate interpolation. The 
+ * register is read once per ANCHOR_POLL_INTERVAL rather than back to back, so the wait is about 1000 transfers at most
  *
- * @param Delta, how many seconds from now the alarm should be set for 
- * @param bool, AlarmVal, determine which alarm to be set
+ * @param AlignToEdge, wait for the next seconds rollover before anchoring
  * @return int, the I2C status value (if any error occours)
  */
-int MCP79412::setAlarm(unsigned int Delta, bool AlarmNum) //Set alarm from current time to x seconds from current time 
-{ 
-	//DEFINE LIMITS FOR FUNCTION!!
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmNum == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-
-	// ClearBit(Control, 4 + AlarmNum); //Turn off desired alarm bit (ALM0 or ALM1)
-	enableAlarm(false, AlarmNum); //Disable desired alarm
-
-	// if(Seconds == 60) { //Will trigger every minute, on the minute 
-	// 	// uint8_t AlarmMask = 0x07; //nibble for A1Mx values
-
-	// 	// // Wire.beginTransmission(ADR);
-	// 	// // Wire.write(0x0E); //Write values to control reg
-	// 	// // Wire.write(0x40); //Turn on 1 Hz square wave
-	// 	// // Wire.endTransmission(); 
-
-	// 	// Wire.beginTransmission(ADR);
-	// 	// Wire.write(0x0E); //Write values to control reg
-	// 	// Wire.write(0x06); //Turn on INTCN and Alarm 2
-	// 	// Wire.endTransmission(); 
-
-	// 	// //DEBUG!
-	// 	// Wire.beginTransmission(ADR);
-	// 	// Wire.write(0x0F); //Write values to control reg
-	// 	// Wire.write(0x00); //Clear any alarm flags, set oscilator to run
-	// 	// Wire.endTransmission(); 
-
-	// 	// for(int i=0; i < 3;i++){
-	// 	// 	Wire.beginTransmission(ADR);
-	// 	// 	Wire.write(0x0B + i); //Write values starting at reg 0x0B
-	// 	// 	// Wire.write(((AlarmMask & (1 << i)) << 8)); //Write time date values into regs
-	// 	// 	Wire.write(0x80); 
-	// 	// 	Wire.endTransmission(); //return result of begin, reading is optional
-	// 	// }
-	// 	ClearBit(Control, 4 + AlarmVal); //Turn off desired alarm bit (ALM0 or ALM1)
-	// 	uint8_t AlarmRegTemp = ReadByte(AlarmRegs::WeekDay + RegOffset); //Read in week day alarm reg for other values in reg
-	// 	AlarmRegTemp = AlarmRegTemp & 0x8F; //Clear mask bits, match only seconds
-	// 	WriteByte(AlarmRegs::WeekDay + RegOffset, AlarmRegTemp); //Write back config reg
-	// 	WriteByte(AlarmRegs::Seconds, 0x00); //Write for alarm to trigger at 0 seconds 
-	// 	SetBit(Control, 4 + AlarmVal); //Turn desired alarm (ALM0 or ALM1) back on
-	// }
-
-	// else {
-	//Currently can not set timer for more than 24 hours
-	// uint8_t AlarmMask = 0x08; //nibble for A1Mx values
-	// uint8_t DY = 0; //DY/DT value 
-	// GetTime(MCP79412::Format::ISO_8601);
-	Timestamp t = getRawTime();
-
-	Time_Date[5] = t.sec; //FIX!
-	Time_Date[4] = t.min;
-	Time_Date[3] = t.hour;
-	Time_Date[2] = t.mday;
-	Time_Date[1] = t.month;
-	Time_Date[0] = t.year;
-
-	int AlarmTime[7] = {Time_Date[5], Time_Date[4], Time_Date[3], t.wday, Time_Date[2], Time_Date[1], Time_Date[0]};
-	// int AlarmVal[7] = {Delta % 60, ((Delta - (Delta % 60))/60) % 60, ((Delta - (Delta % 3600))/3600) % 24, ((Delta - (Delta % 3600))/3600) % 24, ((Delta - (Delta % 86400))/86400), 0, 0};  //Remove unused elements?? FIX!
-	int AlarmVal[7] = {Delta % 60, ((Delta - (Delta % 60))/60) % 60, ((Delta - (Delta % 3600))/3600) % 24, ((Delta - (Delta % 86400))/86400), ((Delta - (Delta % 86400))/86400), 0, 0};  //Remove unused elements?? FIX!
-	int CarryIn = 0; //Carry value
-	int CarryOut = 0; 
-	int MonthDay[13] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};  //Use??
-	//Check if the next year is a leap year 
-	// bool LeapYear = false; //Flag to check if it is a leap year
-	// if(AlarmTime[6] % 400 == 0) LeapYear = true; //If year is divisable by 400, is leap year, set leap year flag
-	// else if((AlarmTime[6] % 4 == 0) && (AlarmTime[6] % 100 != 0)) LeapYear = true; //Otherwise, if IS dividsable by 4, but NOT multiple of 100, is leap year, set leap year flag
-
-	
-
-	if(readBit(Regs::Month, 5)) MonthDay[2] = 29; //If LPYR is set, then adjust number of days in Febuary //FIX! Check if this is correct in terms of setting an alarm into next year 
-	// if(LeapYear) {
-	// 	MonthDay[2] = 29; //Correct days in Febuary
-	// }
-
-	// Wire.beginTransmission(ADR);
-	// Wire.write(0x0E); //Write values to control reg
-	// Wire.write(0x05); //Turn on INTCN and Alarm 1
-	// Wire.endTransmission(); 
-	
-
-	//Calc seconds
-	if(AlarmTime[0] + AlarmVal[0] >= 60) CarryOut = 1;
-	AlarmTime[0] = (AlarmTime[0] + AlarmVal[0]) % 60;
-	CarryIn = CarryOut; //Copy over prevous carry
-
-	//Calc minutes
-	if(AlarmTime[1] + AlarmVal[1] + CarryIn >= 60) CarryOut = 1;
-	else CarryOut = 0;
-	AlarmTime[1] = (AlarmTime[1] + AlarmVal[1] + CarryIn) % 60;
-	CarryIn = CarryOut; //Copy over prevous carry
-
-	//Calc hours
-	if(AlarmTime[2] + AlarmVal[2] + CarryIn >= 24) CarryOut = 1; //OUT OF RANGE??
-	else CarryOut = 0;
-	AlarmTime[2] = (AlarmTime[2] + AlarmVal[2] + CarryIn) % 24;
-	CarryIn = CarryOut; //Copy over prevous carry
-
-	// //Calc DoW
-	// if(AlarmTime[3] + AlarmVal[3] + CarryIn >= 7) CarryOut = 1; //OUT OF RANGE??
-	// else CarryOut = 0;
-	// AlarmTime[3] = (AlarmTime[3] + AlarmVal[3] + CarryIn) % 7;
-	// CarryIn = CarryOut; //Copy over prevous carry
-
-	//Calc DoW
-	// if(AlarmTime[3] + AlarmVal[3] + CarryIn >= 7) CarryOut = 1; //OUT OF RANGE??
-	// else CarryOut = 0;
-	AlarmTime[3] = ((AlarmTime[3] + AlarmVal[3] + CarryIn - 1) % 7) + 1; //Calc DoW change, no need to carry
-	// CarryIn = CarryOut; //Copy over prevous carry
-
-	//Calc days 
-	if(AlarmTime[4] + AlarmVal[4] + CarryIn > MonthDay[AlarmTime[5]]) CarryOut = 1;  //Carry out if result pushes you beyond current month 
-	else CarryOut = 0;
-	AlarmTime[4] = (AlarmTime[4] + AlarmVal[4] + CarryIn) % (MonthDay[AlarmTime[5]] + 1);
-	if(AlarmTime[4] == 0) AlarmTime[4] = 1; //FIX! Find more elegant way to do this
-
-	//Calc Months
-	AlarmTime[5] = ((AlarmTime[5] + CarryOut - 1) % 12) + 1; //If needed, push into next month, if this rolls over into the next year, simply roll over 
-	// AlarmTime[5] = ((AlarmTime[5] + CarryOut) % 13) + int((AlarmTime[5] + CarryOut)/13); //If needed, push into next month, if this rolls over into the next year, simply roll over 
-
-	// int q = 5; //DEBUG!
-	// for(int i = 0; i < 7; i++) { //DEBUG!
-	// 	if(i != 3) {
-	// 		Serial.print(Time_Date[q]); 
-	// 		q--;
-	// 	}
-	// 	if(i == 3) Serial.print(t.wday);
-	// 	Serial.print('\t');
-	// 	Serial.println(AlarmTime[i]);
-	// 	// if(i != 3) q--; //Do no decrement for DoW
-	// 	// q--;
-	// }
-
-
-	//ADD FAILURE NOTIFICATION FOR OUT OF RANGE??
-	for(int i=0; i<=5;i++){
-		if(i == 3) {
-			uint8_t DoW_Temp = readByte(Regs::WeekDay + RegOffset); //Read in current value
-			DoW_Temp = DoW_Temp & 0xF8; //Clear lower 3 bits (day of week portion of register)
-			DoW_Temp = DoW_Temp | 0x70 | (AlarmTime[i] & 0x07); //Set lower 3 bits from DoW input, set MSK bits to configure for full match
-			AlarmTime[i] = DoW_Temp; //Return value  
-		}
-		else { //Otherwise write method for other regs
-			int b = AlarmTime[i]/10;
-			int a = AlarmTime[i]-b*10;
-			if(i == 2){
-				if (b==2)
-					b=B00000010;
-				else if (b==1)
-					b=B00000001;
-			}	
-			AlarmTime[i]= a+(b<<4);
-			// if(i == 0) AlarmTime[i] = AlarmTime[i] | 0x80; //Set ST bit to keep oscilator running 
-
-			//FIX! Test for leap year and set LPYR bit
+int MCP79412::syncAnchor(bool AlignToEdge)
+{
+	time_t Time = 0;
+	int Error = readClock(Time);
+	uint32_t Now = millis();
+	if(Error != 0) return Error;
+	if(AlignToEdge) {
+		uint8_t Start = 0;
+		uint8_t Sec = 0;
+		Error = bus->read(ADR, MCP79412Regs::RTCSEC, &Start, 1);
+		Sec = Start;
+		while(Error == 0 && Sec == Start && (millis() - Now) < 1100) { //Wait at most a little over a second for the edge
+			delay(ANCHOR_POLL_INTERVAL); //Leave the bus to other users between reads
+			Error = bus->read(ADR, MCP79412Regs::RTCSEC, &Sec, 1);
 		}
-		writeByte(Regs::Seconds + RegOffset + i, AlarmTime[i]); //Write AlarmTime back to specified alarm register 
-		// Serial.println(AlarmTime[i], HEX); //DEBUG!
-		// delay(1);
-		// delayMicroseconds(150); //DEBUG!
-	}
-
-
-	// int Offset = 0;
-	// for(int i=0; i<=6;i++){
-	// 	if(i==3) i++;
-	// 	int b= AlarmTime[i]/10;
-	// 	int a= AlarmTime[i]-b*10;
-	// 	if(i==2){
-	// 		if (b==2)
-	// 			b=B00000010;
-	// 		else if (b==1)
-	// 			b=B00000001;
-	// 	}	
-	// 	AlarmTime[i]= a+(b<<4);
-		  
-	// 	Wire.beginTransmission(ADR);
-	// 	Wire.write(0x07 + Offset); //Write values starting at reg 0x07
-	// 	Wire.write(AlarmTime[i] | ((AlarmMask & (1 << Offset)) << 8)); //Write time date values into regs
-	// 	Wire.endTransmission(); //return result of begin, reading is optional
-	// 	Offset++;
-	// }
-	// }
-	// }
-
-	//FIX! Should the alarm be turned on before status is cleared, or vise-versa??
-	// SetBit(Control, 4 + AlarmNum); //Turn desired alarm (ALM0 or ALM1) back on 
-	int Error = enableAlarm(true, AlarmNum); //Re-enable alarm
-	clearAlarm(AlarmNum); //Clear any existing alarm
-	return Error; //Return the error from enabling the alarm
+		if(Error != 0) return Error;
+		Error = readClock(Time); //Read full time just after edge, handles carry into minutes and beyond
+		Now = millis();
+		if(Error != 0) return Error;
+	}
 
+	if(anchorValid) { //Compare prediction from old anchor with the new reading
+		int64_t Predicted = (int64_t)anchorTime*1000 + (Now - anchorMillis);
+		anchorDrift = (int32_t)(Predicted - (int64_t)Time*1000);
+		uint32_t Magnitude = anchorDrift < 0 ? -anchorDrift : anchorDrift;
+		if(Magnitude > anchorDriftLimit) anchorActiveInterval = anchorActiveInterval/2 < 1000 ? 1000 : anchorActiveInterval/2; //Re-anchor sooner
+		else anchorActiveInterval = anchorActiveInterval*2 > anchorInterval || anchorActiveInterval*2 < anchorActiveInterval ? anchorInterval : anchorActiveInterval*2; //Relax back to configured period
+	}
+	anchorTime = Time;
+	anchorMillis = Now;
+	anchorAligned = AlignToEdge;
+	anchorValid = true;
+	return 0;
 }
 
 /**
- * Set alarm for to trigger once a minute at a given second period offset
+ * Report how stale the time anchor is
  *
- * @param Offset, how many seconds to offset on the minute alarm (if set to 30, the alarm will trigger every minute on the half minute)
- * @param bool, AlarmVal, determine which alarm to be set
- * @return int, the I2C status value (if any error occours)
+ * @return uint32_t, ms since the last anchor, 0xFFFFFFFF if there is no valid anchor
  */
-int MCP79412::setMinuteAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
-{ 
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-
-	// ClearBit(Control, 4 + AlarmVal); //Turn off desired alarm bit (ALM0 or ALM1)
-	enableAlarm(false, AlarmVal); //Disable desired alarm
-	uint8_t AlarmRegTemp = readByte(Regs::WeekDay + RegOffset); //Read in week day alarm reg for other values in reg
-	AlarmRegTemp = AlarmRegTemp & 0x8F; //Clear mask bits, match only seconds
-	writeByte(Regs::WeekDay + RegOffset, AlarmRegTemp); //Write back config reg
-
-	uint8_t SecondsOffset = (Offset % 0x0A) | (uint8_t(floor(Offset/10)) << 4); //Convert offset to BCD
-	writeByte(Regs::Seconds + RegOffset, SecondsOffset); //Write for alarm to trigger at offset period  
-	// SetBit(Control, 4 + AlarmVal); //Turn desired alarm (ALM0 or ALM1) back on
-	int Error = enableAlarm(true, AlarmVal); //Re-enable alarm
-	clearAlarm(AlarmVal); //Clear any existing alarm
-	return Error; //Return the error from enabling the alarm
+uint32_t MCP79412::getAnchorAge()
+{
+	if(!anchorValid) return 0xFFFFFFFF;
+	return millis() - anchorMillis;
 }
+#endif
 
 /**
- * Set alarm for to trigger once a hour at a given minutes period offset
+ * Helper function, reads the current time from the device as Unix time
  *
- * @param Offset, how many minutes to offset on the minute alarm (if set to 30, the alarm will trigger every hour on the half hour)
- * @param bool, AlarmVal, determine which alarm to be set
+ * @param Time, set to the current time if read is successful
+ * @param WDay, if not NULL set to the weekday register
  * @return int, the I2C status value (if any error occours)
  */
-int MCP79412::setHourAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
-{ 
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-
-	// ClearBit(Control, 4 + AlarmVal); //Turn off desired alarm bit (ALM0 or ALM1)
-	enableAlarm(false, AlarmVal); //Disable desired alarm
-	uint8_t AlarmRegTemp = readByte(Regs::WeekDay + RegOffset); //Read in week day alarm reg for other values in reg
-	AlarmRegTemp = AlarmRegTemp & 0x8F; //Clear mask bits
-	AlarmRegTemp = AlarmRegTemp | 0x10; //Set ALMxMSK0, match only minutes
-	writeByte(Regs::WeekDay + RegOffset, AlarmRegTemp); //Write back config reg
-
-	uint8_t MinuteOffset = (Offset % 0x0A) | (uint8_t(floor(Offset/10)) << 4); //Convert offset to BCD
-	writeByte(Regs::Minutes + RegOffset, MinuteOffset); //Write for alarm to trigger at offset period  
-	// SetBit(Control, 4 + AlarmVal); //Turn desired alarm (ALM0 or ALM1) back on
-	int Error = enableAlarm(true, AlarmVal); //Re-enable alarm
-	clearAlarm(AlarmVal); //Clear any existing alarm
-	return Error; //Return the error from enabling the alarm
+int MCP79412::readClock(time_t &Time, uint8_t *WDay)
+{
+	uint8_t Raw[7] = {0};
+	int Error = bus->read(ADR, MCP79412Regs::RTCSEC, Raw, sizeof(Raw)); //Read values starting at reg 0x00
+	if(Error != 0) return Error;
+	Timestamp t = decodeTime(Raw);
+	Time = toUnix(t);
+	if(WDay != NULL) *WDay = t.wday;
+	return 0;
 }
 
 /**
- * Set alarm for to trigger once a day at a given hour period offset
+ * Read the time from a group of devices back-to-back (one burst each, nothing else between them) so their clocks can
+ * be compared. Each sample carries the micros() of its transfer, the skew of device i against device 0 is about 
+ * (time[i] - time[0]) - (readAt[i] - readAt[0])/1e6 seconds. Devices may share a bus or mux, switching channels adds 
+ * one byte write to that device's read
  *
- * @param Offset, how many seconds to offset on the minute alarm (if set to 6, the alarm will trigger every day at 6AM)
- * @param bool, AlarmVal, determine which alarm to be set
- * @return int, the I2C status value (if any error occours)
+ * @param Devices, the devices to read
+ * @param Count, number of devices
+ * @param Samples, one per device, filled in order
+ * @return int, the I2C status value of the first read which failed, 0 if all reads succeeded
  */
-int MCP79412::setDayAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
-{ 
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-
-	// ClearBit(Control, 4 + AlarmVal); //Turn off desired alarm bit (ALM0 or ALM1)
-	enableAlarm(false, AlarmVal); //Disable desired alarm
-	uint8_t AlarmRegTemp = readByte(Regs::WeekDay + RegOffset); //Read in week day alarm reg for other values in reg
-	AlarmRegTemp = AlarmRegTemp & 0x8F; //Clear mask bits
-	AlarmRegTemp = AlarmRegTemp | 0x20; //Set ALMxMSK1, match only hours
-	writeByte(Regs::WeekDay + RegOffset, AlarmRegTemp); //Write back config reg
-
-	uint8_t HourOffset = (Offset % 0x0A) | (uint8_t(floor(Offset/10)) << 4); //Convert offset to BCD 
-	writeByte(Regs::Hours + RegOffset, HourOffset); //Write for alarm to trigger at offset period  
-	// SetBit(Control, 4 + AlarmVal); //Turn desired alarm (ALM0 or ALM1) back on
-	int Error = enableAlarm(true, AlarmVal); //Re-enable alarm
-	clearAlarm(AlarmVal); //Clear any existing alarm
-	return Error; //Return the error from enabling the alarm
+int MCP79412::readTimeGroup(MCP79412 *const Devices[], size_t Count, GroupSample Samples[])
+{
+	int Result = 0;
+	for(size_t i = 0; i < Count; i++) {
+		uint32_t Start = micros();
+		Samples[i].error = Devices[i]->readClock(Samples[i].time);
+		Samples[i].readAt = Start + (micros() - Start)/2;
+		if(Samples[i].error != 0 && Result == 0) Result = Samples[i].error;
+	}
+	return Result;
 }
 
 /**
- * Set the register bit to clear any current alarm flags, effectively disables alarm until SetAlarm() is called again
+ * Return specific time date value to not be forced to parse string 
  *
- * @param bool, AlarmVal, determine which alarm to be set
- * @return int, the I2C status value (if any error occours)
+ * @param n, which value to be returned (0:Year, 1:Month, 2:Day, 3:Hour, 4:Minute, 5:Second)
+ * @return int, the desired time date value in numerical form 
  */
-int MCP79412::clearAlarm(bool AlarmVal) {  //Clear registers to stop alarm, must call SetAlarm again to get it to turn on again
-	// Wire.beginTransmission(ADR);
-	// Wire.write(0x0F); //Write values to status reg
-	// Wire.write(0x00); //Clear all flags
-	// Wire.endTransmission(); //return result of begin, reading is optional
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-	return clearBit(Regs::WeekDay + RegOffset, 3); //Clear interrupt flag bit of the desired alarm register 
+int MCP79412::getValue(int n)	// n = 0:Year, 1:Month, 2:Day, 3:Hour, 4:Minute, 5:Second
+{
+	#if defined(MCP79412_LEAN)
+	Snapshot Snap; //No snapshot is kept, every call is one burst read
+	readSnapshot(Snap);
+	return Snap.value(n);
+	#else
+	if(!snapshot.valid || (millis() - snapshot.captured) >= SNAPSHOT_MAX_AGE) readSnapshot(snapshot); //Update time, a run of calls is served from one read
+	return snapshot.value(n); //Return desired value 
+	#endif
 }
 
 /**
- * Turns on the desired alarm to allow them to generate interrupts 
+ * Read registers 0x00~0x1F (time, control, trim, both alarm blocks and power-fail stamps) in one burst so all fields 
+ * come from the same instant and cannot tear across a second boundary
  *
- * @param bool, State, if the alarm should be enabled or disabled (enables by default)
- * @param bool, AlarmVal, determine which alarm to be set (alarm 0 by default)
- * @return int, the I2C status value (if any error occours)
+ * @param Snap, snapshot to fill
+ * @return int, the I2C status value (if any error occours), Snap.valid is false on error
  */
-int MCP79412::enableAlarm(bool State, bool AlarmVal) {  //Clear registers to stop alarm, must call SetAlarm again to get it to turn on again
-	uint8_t RegOffset = BlockOffset; 
-	clearBit(Control, 6); //If an alarm is in use, disable square wave output //DEBUG! 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-	if(State) return setBit(Control, 4 + AlarmVal); //Set enable bit of desired alarm
-	else if(!State) return clearBit(Control, 4 + AlarmVal); //Clear enable bit of desired alarm
-	else return -1; //Return on unknown input, should never occour 
+int MCP79412::readSnapshot(Snapshot &Snap)
+{
+	int Error = bus->read(ADR, MCP79412Regs::RTCSEC, Snap.regs, sizeof(Snap.regs));
+	Snap.captured = millis();
+	Snap.valid = (Error == 0);
+	if(Error == 0) { //Config registers are known, refresh cache if in use
+		for(int i = 0; i < CACHE_SIZE; i++) {
+			cacheStore(CacheRegs[i], Snap.regs[CacheRegs[i]]);
+		}
+	}
+	return Error;
 }
 
 /**
- * Read the value of the given alarm flags, which are set when the alarm is triggere d 
+ * Read the power-down and power-up stamps, the time they are referenced to and PWRFAIL in one burst. Clearing PWRFAIL
+ * also clears the stamps on the device, so each outage is reported once. Call at boot to mark the gap in the data
  *
- * @param bool, AlarmVal, determine which alarm to be set
- * @return bool, the state of the alarm flag
+ * @param Out, set to the outage interval, Out.valid is false if no outage has been recorded since the last clear
+ * @param Clear, clear PWRFAIL (and the stamps) after reading
+ * @return int, the I2C status value (if any error occours)
  */
-bool MCP79412::readAlarm(bool AlarmVal) {  //Clear registers to stop alarm, must call SetAlarm again to get it to turn on again
-	// Wire.beginTransmission(ADR);
-	// Wire.write(0x0F); //Write values to status reg
-	// Wire.write(0x00); //Clear all flags
-	// Wire.endTransmission(); //return result of begin, reading is optional
-	uint8_t RegOffset = BlockOffset; 
-	if(AlarmVal == 1) RegOffset = AlarmOffset + BlockOffset; //Set offset if using ALM1
-	return readBit(Regs::WeekDay + RegOffset, 3); //Read interrupt flag bit of the desired alarm register 
+int MCP79412::readOutage(Outage &Out, bool Clear)
+{
+	MCP79412Bus::Guard Lock(*bus); //PWRFAIL must not be cleared over an outage which was not read
+	#if defined(MCP79412_LEAN)
+	Snapshot Snap;
+	#else
+	Snapshot &Snap = snapshot; //Keep the getValue() snapshot current
+	#endif
+	int Error = readSnapshot(Snap);
+	if(Error != 0) return Error;
+	if(!Snap.outage(Out) || !Clear) return 0;
+	Error = writeByte(MCP79412Regs::RTCWKDAY, Snap.regs[MCP79412Regs::RTCWKDAY] & ~MCP79412Regs::PWRFAIL); //OSCRUN is read only
+	if(Error != 0) return Error;
+	Snap.regs[MCP79412Regs::RTCWKDAY] &= ~MCP79412Regs::PWRFAIL;
+	memset(Snap.regs + MCP79412Regs::PWRDN, 0, MCP79412Regs::SRAM - MCP79412Regs::PWRDN); //Cleared by hardware along with PWRFAIL
+	Snap.valid = true; //Image was patched to match the device
+	return 0;
+}
+
+MCP79412::Timestamp MCP79412::Snapshot::time() const
+{
+	return decodeTime(regs);
+}
+
+time_t MCP79412::Snapshot::unixTime() const
+{
+	return toUnix(time());
 }
 
 /**
- * Read the UUID from the memory on the RTC and report back as string
+ * Decode the power-down (0x18~0x1B) and power-up (0x1C~0x1F) stamps. The stamps hold no year or seconds, the power-up
+ * year is taken from the clock (previous year if the stamp is later in the year than now) and the power-down year 
+ * from the power-up stamp in the same way, so outages up to a year long are placed correctly
  *
- * @return String, a '-' seperated hex encoded UUID
+ * @param Out, set to the outage interval, Out.valid is false if PWRFAIL is not set
+ * @return bool, true if an outage was decoded
  */
-String MCP79412::getUUIDString() {
-	uint8_t val = 0; 
-	String uuid = "";
-	Wire.beginTransmission(ADR_EEPROM); //EEPROM address
-	Wire.write(0xF0); //Begining of EUI-64 data
-	int error = Wire.endTransmission();
-	if(error == 0) { //Only attempt to read in if there are no errors
-		Wire.requestFrom(ADR_EEPROM, 8); //EEPROM address
-		for(int i = 0; i < 8; i++) {
-			val = Wire.read();
-			uuid = uuid + String(val, HEX); //Concatonate into full UUID
-			if(i < 7) uuid = uuid + '-'; //Print formatting chracter, don't print on last pass
-		}
-		return uuid; //Only return UUID if read was good
+bool MCP79412::Snapshot::outage(Outage &Out) const
+{
+	Out = Outage();
+	if(!powerFail()) return false;
+	Timestamp Now = time();
+	Timestamp Stamps[2]; //Down, up
+	for(int i = 0; i < 2; i++) {
+		const uint8_t *Raw = i == 0 ? powerDown() : powerUp();
+		Stamps[i].sec = 0;
+		Stamps[i].min = fromBCD(Raw[0], MIN_MASK);
+		Stamps[i].hour = fromBCD(Raw[1], HOUR_MASK); //24-hour time
+		Stamps[i].mday = fromBCD(Raw[2], DATE_MASK);
+		Stamps[i].month = fromBCD(Raw[3], MONTH_MASK); //Weekday is in upper 3 bits
+		Stamps[i].wday = Raw[3] >> 5;
 	}
-	else {
-		throwError(RTC_EEPROM_READ_FAIL);
-		return "null"; //Otherwise return null state
+	for(int i = 1; i >= 0; i--) {
+		const Timestamp &Ref = i == 1 ? Now : Stamps[1]; //Each stamp is at or before the following event
+		Stamps[i].year = Ref.year;
+		if(toUnix(Stamps[i]) > toUnix(Ref) + 59) Stamps[i].year--; //Allow for the missing seconds
 	}
+	Out.down = toUnix(Stamps[0]);
+	Out.up = toUnix(Stamps[1]);
+	Out.duration = Out.up > Out.down ? (uint32_t)(Out.up - Out.down) : 0;
+	Out.valid = true;
+	return true;
 }
 
 /**
- * Read the UUID from the memory on the RTC and report back as number
+ * Return specific time date value from the snapshot
  *
- * @return uint64_t, the 64 bit value of the UUID
+ * @param n, which value to be returned (0:Year, 1:Month, 2:Day, 3:Hour, 4:Minute, 5:Second)
+ * @return int, the desired time date value in numerical form, -1 if n is out of range
  */
-uint64_t MCP79412::getUUID() {
-	uint8_t val = 0; 
-	uint64_t uuid = 0; 
-	Wire.beginTransmission(ADR_EEPROM); //EEPROM address
-	Wire.write(0xF0); //Begining of EUI-64 data
-	int error = Wire.endTransmission();
-	if(error == 0) {
-		Wire.requestFrom(ADR, 8); //EEPROM address
-		for(int i = 0; i < 8; i++) {
-			val = Wire.read();
-			uuid = uuid | (val << (8 - i)); //Concatonate into full UUID
-			// Serial.print(Val, HEX); //Print each hex byte from left to right
-			if(i < 7) Serial.print('-'); //Print formatting chracter, don't print on last pass
-		}
-		return uuid;
-	}
-	else {
-		throwError(RTC_EEPROM_READ_FAIL);
-		return 0; //Otherwise return null state
+int MCP79412::Snapshot::value(int n) const
+{
+	switch(n) {
+	case 0: return fromBCD(regs[MCP79412Regs::RTCYEAR]) + 2000;
+	case 1: return fromBCD(regs[MCP79412Regs::RTCMTH], MONTH_MASK);
+	case 2: return fromBCD(regs[MCP79412Regs::RTCDATE], DATE_MASK);
+	case 3: return fromBCD(regs[MCP79412Regs::RTCHOUR], HOUR_MASK);
+	case 4: return fromBCD(regs[MCP79412Regs::RTCMIN], MIN_MASK);
+	case 5: return fromBCD(regs[MCP79412Regs::RTCSEC], SEC_MASK);
+	default: return -1;
 	}
-	// Serial.print("\n");
 }
 
 /**
- * Starts the crystal oscilator connected to the device (required to keep time)
+ * Setup the output mode of the system, using normal or inverted polarity. See page 27 of MCP79412 (Table 5-10 and Table 5-9)
  *
- * @return bool, state of oscilator at end of startup (1 = running, 0 = not running, error)
+ * @param Val, which selects either Normal or Inverted polarity
+ * @return int, the result of the I2C write 
  */
-bool MCP79412::startOsc() //Turn on oscilator, returs TRUE if oscilator is set properly, false otherwise 
+int MCP79412::setMode(Mode Val) 
 {
-	uint8_t ControlTemp = readByte(Control);
-	ControlTemp = ControlTemp & 0xF7; //Clear EXTOSC bit to enable and external oscilator 
-	uint8_t SecTemp = readByte(Regs::Seconds); //Read value from seconds register to use as mask
-	SecTemp = SecTemp | 0x80; //Set ST bit to start oscilator
-	writeByte(Control, ControlTemp); //Write back value of temp control register
-	writeByte(Regs::Seconds, SecTemp); //Write back value of seconds register (for ST bit)
-	delay(5); //Wait for oscilator to start 
-	// Serial.println(ControlTemp, HEX); //DEBUG!
-	// Serial.println(SecTemp, HEX); //DEBUG!
-	// Serial.println(Control, HEX); //DEBUG!
-	// Serial.println(TimeRegs::Seconds, HEX); //DEBUG!
-	return readBit(Regs::WeekDay, 5); //Return the OSCRUN bit of the weekday register to test if oscilator is running
+	#if !defined(MCP79412_LEAN)
+	alarmArmed = 0; //ALMPOL is part of the committed alarm images
+	#endif
+	if(Val == Mode::Normal) return updateBits(MCP79412Regs::Alarm<0>::WKDAY, MCP79412Regs::ALMPOL, 0); //Clear ALMPOL in ALM0WKDAY (mirrored by hardware in ALM1WKDAY)
+	if(Val == Mode::Inverted) return updateBits(MCP79412Regs::Alarm<0>::WKDAY, 0, MCP79412Regs::ALMPOL); //Set ALMPOL in ALM0WKDAY (mirrored by hardware in ALM1WKDAY)
+	else return -1; //Return unknown input error 
 }
 
 /**
- * Helper function, reads byte and given register location
+ * Set alarm for a given number of seconds from current time 
  *
- * @param Reg, the register to read the byte from 
- * @return uint8_t, returns the desired byte
+ * @param Delta, how many seconds from now the alarm should be set for (less than one year)
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours), -1 if Delta is a year or more
  */
-uint8_t MCP79412::readByte(int Reg)
-{
-	Wire.beginTransmission(ADR); //Point to desired register 
-	Wire.write(Reg);
-	Wire.endTransmission();
-
-	Wire.requestFrom(ADR, 1); //Ask for 1 byte from RTC
-	const unsigned long Timeout = 5; 
-	unsigned long LocalTime = millis();
-	while(Wire.available() < 1 && (millis() - LocalTime) < Timeout); //Wait at most 5ms for byte to arrive
-	if(Wire.available() >= 1) return Wire.read(); //If got byte, return value
-	else return 0; //Otherwise return zero 
+int MCP79412::setAlarm(unsigned int Delta, bool AlarmNum) //Set alarm from current time to x seconds from current time 
+{ 
+	time_t Now = 0;
+	uint8_t WDay = 0;
+	int Error = readClock(Now, &WDay);
+	if(Error != 0) return Error;
+	return commitAlarmAt(Now + (time_t)Delta, Now, WDay, AlarmNum);
 }
 
 /**
- * Helper function, write value (byte) to register at given register location
+ * Set alarm to trigger at an absolute time, as a full match (seconds through month). The date is found by calendar 
+ * arithmetic so month and year rollover are handled, the weekday is counted forward from the device weekday
  *
- * @param Reg, the location of the register to write the data to
- * @param Val, the value of the data to write to the register 
- * @return int, I2C status
+ * @param Time, Unix time (UTC) to trigger at, from now up to (not including) one year ahead
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours), -1 if the time is in the past or a year or more ahead
  */
-int MCP79412::writeByte(int Reg, uint8_t Val)
+int MCP79412::setAlarmAt(time_t Time, bool AlarmVal)
 {
-	Wire.beginTransmission(ADR);
-	Wire.write(Reg);
-	Wire.write(Val); //Write value to register
-	return Wire.endTransmission(); //Return I2C status 
+	time_t Now = 0;
+	uint8_t WDay = 0;
+	int Error = readClock(Now, &WDay);
+	if(Error != 0) return Error;
+	return commitAlarmAt(Time, Now, WDay, AlarmVal);
 }
 
 /**
- * Helper function, reads bit value from given byte and retuns this as bool
+ * Set alarm to trigger at an absolute time, see setAlarmAt(time_t)
  *
- * @param Reg, the location of the register to read the data from
- * @param Pos, the position of the bit to return
- * @return bool, the value of the bit at the ith location 
+ * @param Time, calendar time to trigger at, wday is ignored
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours), -1 if the time is in the past or a year or more ahead
  */
-bool MCP79412::readBit(int Reg, uint8_t Pos)
+int MCP79412::setAlarmAt(const Timestamp &Time, bool AlarmVal)
 {
-	uint8_t Val = readByte(Reg);
-	return (Val >> Pos) & 0x01; //Return single reguested bit
+	return setAlarmAt(toUnix(Time), AlarmVal);
 }
 
 /**
- * Helper function, sets a bit at a given location in a register 
+ * Helper function, stages a full match alarm at the given time and commits it
  *
- * @param Reg, the location of the register to set the bit in
- * @param Pos, the position of the bit to set
- * @return int, I2C status 
+ * @param Time, Unix time to trigger at
+ * @param Now, current Unix time of the device
+ * @param WDay, current weekday register of the device
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours), -1 if out of range
  */
-int MCP79412::setBit(int Reg, uint8_t Pos)
+int MCP79412::commitAlarmAt(time_t Time, time_t Now, uint8_t WDay, bool AlarmVal)
 {
-	uint8_t ValTemp = readByte(Reg);
-	ValTemp = ValTemp | (1 << Pos); //Set desired bit
-	// Serial.println(ValTemp, HEX); //DEBUG!
-	return writeByte(Reg, ValTemp); //Write value back in place
+	if(Time < Now || Time - Now >= 365*86400L) return -1; //Alarm has no year, a year ahead would also match sooner
+	AlarmBlock Block;
+	Block.at(Time, Now, WDay);
+	return commitAlarm(Block, AlarmVal);
 }
 
 /**
- * Helper function, clears a bit at a given location in a register 
+ * Helper function, weekday the device will report at a given time, counted forward from its weekday now. The device 
+ * compares its own register, so a weekday never set (0, left by the 6 argument setTime()) stays 0 for the rest of the 
+ * day and counts on from 1 after midnight
+ */
+static uint8_t weekDayAt(time_t Time, time_t Now, uint8_t NowWDay)
+{
+	int32_t Days = (int32_t)(Time / 86400) - (int32_t)(Now / 86400);
+	if(NowWDay == 0) return Days <= 0 ? 0 : (uint8_t)((Days - 1) % 7 + 1);
+	return (uint8_t)((((NowWDay - 1 + Days) % 7) + 7) % 7 + 1);
+}
+
+/**
+ * Stage a full match at a Unix time
  *
- * @param Reg, the location of the register to clear the bit in
- * @param Pos, the position of the bit to clear
- * @return int, I2C status 
+ * @param Time, Unix time (UTC) to match
+ * @param Now, current time of the device, 0 to use the calendar weekday
+ * @param NowWDay, weekday register of the device at Now
+ * @return AlarmBlock&, this block for chaining
  */
-int MCP79412::clearBit(int Reg, uint8_t Pos)
+MCP79412::AlarmBlock& MCP79412::AlarmBlock::at(time_t Time, time_t Now, uint8_t NowWDay)
 {
-	uint8_t ValTemp = readByte(Reg); //Grab register
-	uint8_t Mask = ~(1 << Pos); //Creat mask to clear register
-	ValTemp = ValTemp & Mask; //Clear desired bit
-	return writeByte(Reg, ValTemp); //Write value back
+	Timestamp t = fromUnix(Time);
+	date(t.month, t.mday).time(t.hour, t.min, t.sec).match(AlarmMask::Full);
+	wday = Now != 0 ? weekDayAt(Time, Now, NowWDay) : t.wday;
+	return *this;
 }
 
 /**
- * Reports the current array of errors 
- * 
- * @param errors, array of errors to pass out
- * @return uint8_t, number of errors reported, Note: can exceed MAX_NUM_ERRORS, in this case an overrun has occoured 
+ * Helper function, next time at or after Now that the device will match an alarm block
+ *
+ * @return time_t, the match time, 0 if the block can never match
  */
-uint8_t MCP79412::getErrorsArray(uint32_t errors_[]) 
+static time_t nextMatch(const MCP79412::AlarmBlock &Block, time_t Now, uint8_t NowWDay)
 {
-    for(int i = 0; i < min(MAX_NUM_ERRORS, numErrors); i++) { //Interate over used element of array without exceeding bounds
-		// output = output + String(errors[i]) + ","; //Add each error code
-		errors_[i] = errors[i]; //Copy over errors
-        errors[i] = 0; //Clear as you go
+	MCP79412::Timestamp n = MCP79412::fromUnix(Now);
+	const time_t Minute = Now - n.sec;
+	const time_t Hour = Minute - n.min*60;
+	const time_t Day = Hour - n.hour*3600L;
+	time_t t = 0;
+	switch(Block.mask) {
+	case MCP79412::AlarmMask::Seconds:
+		if(Block.sec > 59) return 0;
+		t = Minute + Block.sec;
+		return t < Now ? t + 60 : t;
+	case MCP79412::AlarmMask::Minutes: //Matches as the minute starts
+		if(Block.min > 59) return 0;
+		t = Hour + Block.min*60;
+		return t < Now ? t + 3600 : t;
+	case MCP79412::AlarmMask::Hours:
+		if(Block.hour > 23) return 0;
+		t = Day + Block.hour*3600L;
+		return t < Now ? t + 86400L : t;
+	case MCP79412::AlarmMask::WeekDay:
+		if(Block.wday < 1 || Block.wday > 7) return 0;
+		t = Day + ((Block.wday - weekDayAt(Now, Now, NowWDay) + 7) % 7)*86400L;
+		return t < Now ? t + 7*86400L : t;
+	case MCP79412::AlarmMask::Date:
+		for(int i = 0; i <= 12; i++) { //Skip months without this date
+			int32_t Year = n.year + (n.month - 1 + i)/12;
+			uint8_t Month = (n.month - 1 + i) % 12 + 1;
+			if(Block.mday < 1 || Block.mday > daysInMonth(Year, Month)) continue;
+			t = (time_t)daysFromCivil(Year, Month, Block.mday)*86400L;
+			if(t >= Now) return t;
+		}
+		return 0;
+	case MCP79412::AlarmMask::Full:
+		if(Block.month < 1 || Block.month > 12 || Block.hour > 23 || Block.min > 59 || Block.sec > 59) return 0;
+		for(int i = 0; i < 28; i++) { //Weekday must match as well, the calendar repeats every 28 years
+			int32_t Year = n.year + i;
+			if(Block.mday < 1 || Block.mday > daysInMonth(Year, Block.month)) continue;
+			t = (time_t)daysFromCivil(Year, Block.month, Block.mday)*86400L + Block.hour*3600L + Block.min*60 + Block.sec;
+			if(t >= Now && weekDayAt(t, Now, NowWDay) == Block.wday) return t;
+		}
+		return 0;
+	default:
+		return 0;
 	}
-    uint8_t numErrorsCurrent = numErrors; //Store temporarily so global can be cleared
-    numErrors = 0; //Clear error count once dumped 
-    return numErrorsCurrent; //Return the number of values written into array
 }
 
 /**
- * Adds the specified error to the growing list of errors
- * 
- * @param errors, new error value to write add to global array
- * @return int, current total number of errors
+ * Read back an alarm. The time registers, CONTROL and the alarm block are read in one burst, so the next match time 
+ * is computed against the same instant the alarm was read. Use to find how long to sleep without tracking what was set
+ *
+ * @param bool, AlarmVal, which alarm to read
+ * @param Info, set to the alarm fields, next match time, enable state and flag
+ * @return int, the I2C status value (if any error occours)
  */
-int MCP79412::throwError(uint32_t error)
+int MCP79412::getAlarm(bool AlarmVal, AlarmInfo &Info)
 {
-	errors[(numErrors++) % MAX_NUM_ERRORS] = error; //Write error to the specified location in the error array
-	// if(numErrors > MAX_NUM_ERRORS) errorOverwrite = true; //Set flag if looping over previous errors 
-	return numErrors;
+	const AlarmMap Map = alarmMap(AlarmVal);
+	uint8_t Raw[MCP79412Regs::Alarm<1>::MTH + 1] = {0}; //Time through end of ALM1 block
+	int Error = bus->read(ADR, MCP79412Regs::RTCSEC, Raw, Map.sec + MCP79412Regs::ALMMTH + 1);
+	if(Error != 0) return Error;
+	const uint8_t *Alm = Raw + Map.sec;
+	Info.block.sec = fromBCD(Alm[MCP79412Regs::ALMSEC], SEC_MASK);
+	Info.block.min = fromBCD(Alm[MCP79412Regs::ALMMIN], MIN_MASK);
+	Info.block.hour = fromBCD(Alm[MCP79412Regs::ALMHOUR], HOUR_MASK);
+	Info.block.wday = Alm[MCP79412Regs::ALMWKDAY] & WDAY_MASK;
+	Info.block.mask = (AlarmMask)((Alm[MCP79412Regs::ALMWKDAY] & MCP79412Regs::ALMMSK) >> MCP79412Regs::ALMMSK_POS);
+	Info.block.mday = fromBCD(Alm[MCP79412Regs::ALMDATE], DATE_MASK);
+	Info.block.month = fromBCD(Alm[MCP79412Regs::ALMMTH], MONTH_MASK);
+	Info.flag = Alm[MCP79412Regs::ALMWKDAY] & MCP79412Regs::ALMIF;
+	Info.enabled = Raw[MCP79412Regs::CONTROL] & Map.en;
+	cacheStore(Map.wkday, Alm[MCP79412Regs::ALMWKDAY]);
+	Info.next = nextMatch(Info.block, toUnix(decodeTime(Raw)), Raw[MCP79412Regs::RTCWKDAY] & WDAY_MASK);
+	return 0;
 }
 
-time_t MCP79412::timegm(struct tm *tm)
-{
-    time_t ret;
-    char *tz;
+/**
+ * Set alarm for to trigger once a minute at a given second period offset
+ *
+ * @param Offset, how many seconds to offset on the minute alarm (if set to 30, the alarm will trigger every minute on the half minute)
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::setMinuteAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
+{ 
+	AlarmBlock Block;
+	Block.time(0, 0, Offset).match(AlarmMask::Seconds); //Match only seconds
+	return commitAlarm(Block, AlarmVal);
+}
+
+/**
+ * Set alarm for to trigger once a hour at a given minutes period offset
+ *
+ * @param Offset, how many minutes to offset on the minute alarm (if set to 30, the alarm will trigger every hour on the half hour)
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::setHourAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
+{ 
+	AlarmBlock Block;
+	Block.time(0, Offset, 0).match(AlarmMask::Minutes); //Match only minutes
+	return commitAlarm(Block, AlarmVal);
+}
+
+/**
+ * Set alarm for to trigger once a day at a given hour period offset
+ *
+ * @param Offset, how many seconds to offset on the minute alarm (if set to 6, the alarm will trigger every day at 6AM)
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::setDayAlarm(unsigned int Offset, bool AlarmVal) //Set alarm from current time to x seconds from current time 
+{ 
+	AlarmBlock Block;
+	Block.time(Offset, 0, 0).match(AlarmMask::Hours); //Match only hours
+	return commitAlarm(Block, AlarmVal);
+}
+
+#if !defined(MCP79412_LEAN)
+/**
+ * Set an alarm which repeats every Period seconds, aligned to the clock so it matches on times where 
+ * (t - Phase) % Period == 0 (e.g. Period = 600, Phase = 0 is every 10 minutes on the 10 minutes). The coarsest 
+ * mask which can express the period is used, so on each trigger only the one changing match register needs rewriting:
+ * seconds mask for periods dividing a minute, minutes mask for whole minute periods dividing an hour, hours mask for 
+ * whole hour periods dividing a day, full match otherwise. When it fires serviceAlarms() re-arms it, a wake is one 
+ * burst read plus one write which also clears the flag. Any other alarm set on the same slot cancels the recurrence 
+ *
+ * @param Period, seconds between matches (1 or more)
+ * @param Phase, alignment offset [s] relative to the Unix epoch, e.g. 300 for 5 minutes past
+ * @param bool, AlarmVal, determine which alarm to be set
+ * @return int, the I2C status value (if any error occours), -1 if the period is invalid
+ */
+int MCP79412::setRecurringAlarm(uint32_t Period, uint32_t Phase, bool AlarmVal)
+{
+	if(Period == 0) return -1;
+	time_t Now = 0;
+	uint8_t WDay = 0;
+	int Error = readClock(Now, &WDay);
+	if(Error != 0) return Error;
+	recurPeriod[AlarmVal] = Period;
+	recurPhase[AlarmVal] = Phase % Period;
+	AlarmBlock Block = recurringBlock(AlarmVal, Now, WDay);
+	Error = writeAlarm(Block, alarmMap(AlarmVal));
+	if(Error != 0) recurPeriod[AlarmVal] = 0; //Alarm state unknown, do not re-arm it from serviceAlarms()
+	return Error;
+}
+
+/**
+ * Move a recurring alarm to its next match after the current time, for use when polling rather than using 
+ * serviceAlarms(). One time read plus one write of the changed registers, which also clears the flag
+ *
+ * @param bool, AlarmVal, determine which alarm to re-arm
+ * @return int, the I2C status value (if any error occours), -1 if no recurring alarm is set
+ */
+int MCP79412::rearmRecurring(bool AlarmVal)
+{
+	if(recurPeriod[AlarmVal] == 0) return -1;
+	time_t Now = 0;
+	uint8_t WDay = 0;
+	int Error = readClock(Now, &WDay);
+	if(Error != 0) return Error;
+	return rearmAlarm(recurringBlock(AlarmVal, Now, WDay), AlarmVal);
+}
+
+/**
+ * Helper function, alarm block for the next match of a recurring alarm after a given time. Fields which are not 
+ * matched are held at fixed values so a re-arm only changes the matched register
+ *
+ * @param bool, AlarmVal, which recurring alarm
+ * @param Now, current Unix time of the device
+ * @param WDay, current weekday register of the device
+ * @return AlarmBlock, the block to program
+ */
+MCP79412::AlarmBlock MCP79412::recurringBlock(bool AlarmVal, time_t Now, uint8_t WDay) const
+{
+	const uint32_t Period = recurPeriod[AlarmVal];
+	const uint32_t Phase = recurPhase[AlarmVal];
+	time_t Next = Now - (time_t)((uint32_t)(Now - Phase) % Period) + Period; //Strictly after now
+	Timestamp t = fromUnix(Next);
+	AlarmBlock Block;
+	if(Period < 60 && 60 % Period == 0) Block.time(0, 0, t.sec).match(AlarmMask::Seconds);
+	else if(Period % 60 == 0 && 3600 % Period == 0 && Phase % 60 == 0) Block.time(0, t.min, 0).match(AlarmMask::Minutes);
+	else if(Period % 3600 == 0 && 86400 % Period == 0 && Phase % 3600 == 0) Block.time(t.hour, 0, 0).match(AlarmMask::Hours);
+	else Block.at(Next, Now, WDay);
+	return Block;
+}
+#endif
+
+/**
+ * Program a staged alarm into the device, used by commitAlarm(). The full ALMx block (seconds through month) is 
+ * assembled in RAM and written as one burst, which also clears the alarm flag. The alarm is disabled around the write 
+ * (only if it was enabled) so that a partially written block can never match, and re-enabled with a single CONTROL 
+ * write. Uncached this is 3~4 transactions, with the register cache enabled 2~3. Does not change the recurrence
+ *
+ * @param Block, the alarm settings to write
+ * @param Map, registers of the alarm
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::writeAlarm(const AlarmBlock &Block, AlarmMap Map)
+{
+	MCP79412Bus::Guard Lock(*bus); //Disable, write and re-enable as one operation
+	uint8_t ControlTemp = 0;
+	uint8_t Polarity = 0;
+	int Slot = cacheSlot(MCP79412Regs::Alarm<0>::WKDAY);
+	if(Slot >= 0 && (cacheValid & (1 << Slot)) && (cacheValid & 0x01)) { //CONTROL and ALMPOL both cached
+		ControlTemp = cache[0];
+		Polarity = cache[Slot] & MCP79412Regs::ALMPOL;
+	}
+	else {
+		uint8_t Config[MCP79412Regs::Alarm<0>::WKDAY - MCP79412Regs::CONTROL + 1] = {0}; //CONTROL through ALM0WKDAY, ALMPOL is held in ALM0WKDAY
+		int Error = bus->read(ADR, MCP79412Regs::CONTROL, Config, sizeof(Config));
+		if(Error != 0) return Error; 
+		ControlTemp = Config[0];
+		Polarity = Config[sizeof(Config) - 1] & MCP79412Regs::ALMPOL;
+		cacheStore(MCP79412Regs::CONTROL, ControlTemp);
+	}
+
+	ControlTemp = ControlTemp & ~MCP79412Regs::SQWEN; //If an alarm is in use, disable square wave output
+	if(ControlTemp & Map.en) { //Only disable if currently running
+		int Error = writeByte(MCP79412Regs::CONTROL, ControlTemp & ~Map.en);
+		if(Error != 0) return Error;
+	}
+
+	uint8_t Image[MCP79412Regs::Alarm<0>::SIZE];
+	encodeAlarm(Block, Polarity, Image);
+	#if !defined(MCP79412_LEAN)
+	alarmArmed &= ~(1 << Map.num);
+	#endif
+	invalidateSnapshot();
+	int Error = bus->write(ADR, Map.sec, Image, sizeof(Image)); //Write full alarm block
+	if(Error != 0) return Error;
+	cacheStore(Map.wkday, Image[MCP79412Regs::ALMWKDAY]);
+
+	Error = writeByte(MCP79412Regs::CONTROL, ControlTemp | Map.en); //Re-enable alarm
+	#if !defined(MCP79412_LEAN)
+	if(Error == 0) {
+		memcpy(alarmImage[Map.num], Image, sizeof(Image)); //Known contents for moveAlarm()
+		alarmArmed |= 1 << Map.num;
+	}
+	#endif
+	return Error; //Return the error from enabling the alarm
+}
+
+/**
+ * Move an alarm which is already running to a new match, used by rearmAlarm(). The block is compared with what was 
+ * last committed and only the span of registers which differ is written, always extended to ALMxWKDAY so the alarm 
+ * flag is cleared in the same transaction. This is a single write (e.g. minutes + hours + weekday when only the time 
+ * of day moves). If the alarm contents are not known (not committed by this instance, disabled, or mode changed) 
+ * falls back to writing the whole block. The lean build keeps no image and always writes the whole block
+ *
+ * @param Block, the new alarm settings
+ * @param Map, registers of the alarm
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::moveAlarm(const AlarmBlock &Block, AlarmMap Map)
+{
+	#if defined(MCP79412_LEAN)
+	return writeAlarm(Block, Map);
+	#else
+	if(!(alarmArmed & (1 << Map.num))) return writeAlarm(Block, Map); //Keeps the recurrence, this is how a recurring alarm recovers
+	uint8_t *Current = alarmImage[Map.num];
+	uint8_t Image[MCP79412Regs::Alarm<0>::SIZE];
+	encodeAlarm(Block, Current[MCP79412Regs::ALMWKDAY] & MCP79412Regs::ALMPOL, Image);
+
+	uint8_t First = MCP79412Regs::ALMWKDAY;
+	uint8_t Last = MCP79412Regs::ALMWKDAY;
+	for(uint8_t i = 0; i < sizeof(Image); i++) {
+		if(Image[i] == Current[i]) continue;
+		if(i < First) First = i;
+		if(i > Last) Last = i;
+	}
+	invalidateSnapshot();
+	int Error = bus->write(ADR, Map.sec + First, Image + First, Last - First + 1);
+	if(Error != 0) {
+		alarmArmed &= ~(1 << Map.num); //Contents unknown, next arm rewrites the whole block
+		return Error;
+	}
+	memcpy(Current, Image, sizeof(Image));
+	cacheStore(Map.wkday, Image[MCP79412Regs::ALMWKDAY]);
+	return 0;
+	#endif
+}
+
+/**
+ * Turns the alarm on or off, used by enableAlarm(). Sets or clears ALMxEN and clears SQWEN in one read-modify-write
+ *
+ * @param State, if the alarm should be enabled or disabled
+ * @param Map, registers of the alarm
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::setAlarmEnable(bool State, AlarmMap Map)
+{
+	if(!State) {
+		#if !defined(MCP79412_LEAN)
+		alarmArmed &= ~(1 << Map.num); //Next arm must enable it again
+		#endif
+		stopRecurrence(Map.num);
+	}
+	//If an alarm is in use, disable square wave output
+	//Set or clear enable bit of desired alarm in the same read-modify-write
+	return updateBits(MCP79412Regs::CONTROL, MCP79412Regs::SQWEN | Map.en, State ? Map.en : 0);
+}
+
+#if defined(ARDUINO) && !defined(PARTICLE)
+MCP79412* MCP79412::alarmInstance = NULL;
+#endif
+
+/**
+ * Register a function to run when an alarm fires, dispatched by serviceAlarms()
+ *
+ * @param AlarmVal, which alarm the callback is for
+ * @param Callback, function to call with the alarm number and context, NULL to remove
+ * @param Context, passed through to the callback
+ */
+void MCP79412::onAlarm(bool AlarmVal, AlarmCallback Callback, void *Context)
+{
+	alarmCallbacks[AlarmVal] = Callback;
+	alarmContexts[AlarmVal] = Context;
+}
+
+/**
+ * Attach to the GPIO the MFP is connected to, the ISR only records the event. The edge is chosen from the current 
+ * ALMPOL setting (Mode::Normal asserts low, Mode::Inverted asserts high), call again after changing the mode. 
+ * An alarm which is already flagged is serviced on the next call to serviceAlarms()
+ *
+ * @param Pin, the GPIO connected to MFP (open drain, pull-up is enabled)
+ * @return int, 0 on success, -1 if interrupts are not supported on this platform
+ */
+int MCP79412::attachAlarmInterrupt(int Pin)
+{
+	bool Inverted = readByte(MCP79412Regs::Alarm<0>::WKDAY) & MCP79412Regs::ALMPOL;
+	#if defined(PARTICLE)
+		detachAlarmInterrupt();
+		pinMode(Pin, INPUT_PULLUP);
+		if(!attachInterrupt(Pin, &MCP79412::handleInterrupt, this, Inverted ? RISING : FALLING)) return -1;
+	#elif defined(ARDUINO)
+		detachAlarmInterrupt();
+		pinMode(Pin, INPUT_PULLUP);
+		alarmInstance = this;
+		attachInterrupt(digitalPinToInterrupt(Pin), alarmIsr, Inverted ? RISING : FALLING);
+	#else
+		(void)Inverted;
+		(void)Pin;
+		return -1; //No GPIO, feed handleInterrupt() from the platform instead
+	#endif
+	alarmPin = Pin;
+	handleInterrupt(); //MFP may already be asserted, in which case no edge will come
+	return 0;
+}
+
+/**
+ * Release the MFP interrupt, alarms can still be serviced by polling
+ */
+void MCP79412::detachAlarmInterrupt()
+{
+	if(alarmPin < 0) return;
+	#if defined(PARTICLE)
+		detachInterrupt(alarmPin);
+	#elif defined(ARDUINO)
+		detachInterrupt(digitalPinToInterrupt(alarmPin));
+		alarmInstance = NULL;
+	#endif
+	alarmPin = -1;
+}
+
+/**
+ * Handle alarms flagged by the MFP interrupt. If the ISR has not fired this returns without touching the bus, 
+ * otherwise both alarm flags are read in one burst (0x0D~0x14, from 0x00 if a recurring alarm is set), the ones set 
+ * are cleared in one write and the registered callbacks run (after the bus is released). A recurring alarm which 
+ * fired is moved to its next match instead, the same write clears its flag. While a flag is set MFP stays asserted 
+ * and gives no new edge, so the flags are checked again after the clear (MFP pin level if attached, otherwise one 
+ * read) and on any error the event is kept pending, a flag left set is serviced by the next call
+ *
+ * @return int, bit mask of alarms which fired (bit 0 = ALM0, bit 1 = ALM1), I2C status negated if an error occours, 
+ * callbacks of alarms which were cleared still run
+ */
+int MCP79412::serviceAlarms()
+{
+	if(!alarmEvent.exchange(false, std::memory_order_acq_rel)) return 0;
+	uint8_t Fired = 0;
+	int Error = 0;
+	{
+		MCP79412Bus::Guard Lock(*bus); //Flags must not change between read and clear
+		uint8_t Raw[MCP79412Regs::Alarm<1>::WKDAY + 1] = {0}; //Time through ALM1WKDAY
+		const uint8_t First = MCP79412Regs::Alarm<0>::WKDAY;
+		const uint8_t Last = MCP79412Regs::Alarm<1>::WKDAY - First; //ALM1WKDAY relative to ALM0WKDAY
+		const uint8_t Start = (isRecurring(0) || isRecurring(1)) ? MCP79412Regs::RTCSEC : First;
+		uint8_t *Flags = Raw + First;
+		Error = bus->read(ADR, Start, Raw + Start, sizeof(Raw) - Start);
+		if(Error != 0) return retryAlarms(Error);
+		Fired = ((Flags[0] & MCP79412Regs::ALMIF) ? MCP79412Regs::Alarm<0>::FIRED : 0) | ((Flags[Last] & MCP79412Regs::ALMIF) ? MCP79412Regs::Alarm<1>::FIRED : 0);
+		uint8_t Clear = Fired;
+		for(uint8_t i = 0; i < 2; i++) {
+			if(isRecurring(i)) Clear &= ~(1 << i); //Cleared by the re-arm
+		}
+		Flags[0] &= ~MCP79412Regs::ALMIF;
+		Flags[Last] &= ~MCP79412Regs::ALMIF;
+		if(Clear != 0) invalidateSnapshot();
+		if(Clear == 0x03) Error = bus->write(ADR, First, Flags, Last + 1); //Both, write back the block between them unchanged
+		else if(Clear == 0x01) Error = bus->write(ADR, First, &Flags[0], 1);
+		else if(Clear == 0x02) Error = bus->write(ADR, First + Last, &Flags[Last], 1);
+		if(Error != 0) return retryAlarms(Error); //Nothing was cleared
+		cacheStore(First, Flags[0]);
+		cacheStore(First + Last, Flags[Last]);
+
+		#if !defined(MCP79412_LEAN)
+		time_t Now = toUnix(decodeTime(Raw));
+		for(uint8_t i = 0; i < 2; i++) {
+			if(!(Fired & ~Clear & (1 << i))) continue;
+			int RearmError = rearmAlarm(recurringBlock(i, Now, Raw[MCP79412Regs::RTCWKDAY] & WDAY_MASK), i);
+			if(RearmError != 0) {
+				Fired &= ~(1 << i); //Flag is still set, re-armed and reported by the next call
+				Error = RearmError;
+			}
+		}
+		#endif
+
+		bool Asserted = Error != 0; //An alarm which matched after the read keeps MFP asserted
+		#if defined(PARTICLE) || defined(ARDUINO)
+		if(alarmPin >= 0) Asserted = Asserted || digitalRead(alarmPin) == ((Flags[0] & MCP79412Regs::ALMPOL) ? HIGH : LOW);
+		else
+		#endif
+		if(!Asserted) Asserted = bus->read(ADR, First, Flags, Last + 1) != 0 || (Flags[0] & MCP79412Regs::ALMIF) || (Flags[Last] & MCP79412Regs::ALMIF);
+		if(Asserted) alarmEvent.store(true, std::memory_order_release);
+	}
+	for(uint8_t i = 0; i < 2; i++) {
+		if((Fired & (1 << i)) && alarmCallbacks[i] != NULL) alarmCallbacks[i](i, alarmContexts[i]);
+	}
+	return Error != 0 ? -Error : Fired;
+}
+
+/**
+ * Read the UUID from the memory on the RTC and report back as string
+ *
+ * @return String, a '-' seperated hex encoded UUID
+ */
+#if defined(MCP79412_HAS_STRING)
+String MCP79412::getUUIDString() {
+	char uuid[24];
+	if(formatUUID(uuid, sizeof(uuid)) < 0) return "null"; //Only return UUID if read was good
+	return uuid; 
+}
+#endif
+
+/**
+ * Read the UUID from the memory on the RTC and format into a caller provided buffer, does not allocate. Each byte is 
+ * written as lower case hex without leading zeros, '-' seperated (same format as getUUIDString has always reported)
+ *
+ * @param Buffer, destination for the null terminated string
+ * @param Len, size of the buffer (24 bytes is enough for any UUID)
+ * @return int, number of characters written (not including null), -1 if the read failed or the buffer is too small
+ */
+int MCP79412::formatUUID(char *Buffer, size_t Len)
+{
+	const char Hex[] = "0123456789abcdef";
+	uint8_t val[8] = {0}; 
+	while(updateEeprom() == AsyncStatus::Busy); //EEPROM does not respond during write cycle
+	int error = bus->read(ADR_EEPROM, 0xF0, val, sizeof(val)); //Begining of EUI-64 data
+	if(error != 0) {
+		logError(RTC_EEPROM_READ_FAIL);
+		return -1;
+	}
+	char str[24];
+	char *p = str;
+	for(int i = 0; i < 8; i++) {
+		if(val[i] > 0x0F) *p++ = Hex[val[i] >> 4]; //Omit leading zero
+		*p++ = Hex[val[i] & 0x0F];
+		if(i < 7) *p++ = '-'; //Print formatting chracter, don't print on last pass
+	}
+	size_t n = p - str;
+	if(Buffer == NULL || Len < n + 1) return -1; //Does not fit with null terminator
+	memcpy(Buffer, str, n);
+	Buffer[n] = '\0';
+	return n;
+}
+
+/**
+ * Read the UUID from the memory on the RTC and report back as number
+ *
+ * @return uint64_t, the 64 bit value of the UUID
+ */
+uint64_t MCP79412::getUUID() {
+	uint8_t val[8] = {0}; 
+	uint64_t uuid = 0; 
+	while(updateEeprom() == AsyncStatus::Busy); //EEPROM does not respond during write cycle
+	int error = bus->read(ADR_EEPROM, 0xF0, val, sizeof(val)); //Begining of EUI-64 data
+	if(error == 0) {
+		for(int i = 0; i < 8; i++) {
+			uuid = (uuid << 8) | val[i]; //Concatonate into full UUID, first byte is most significant
+		}
+		return uuid;
+	}
+	else {
+		logError(RTC_EEPROM_READ_FAIL);
+		return 0; //Otherwise return null state
+	}
+	// Serial.print("\n");
+}
+
+/**
+ * Starts the crystal oscilator connected to the device (required to keep time), does not wait for it to run, 
+ * see pollBegin()
+ *
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::startOsc()
+{
+	MCP79412Bus::Guard Lock(*bus);
+	uint8_t ControlTemp = readByte(MCP79412Regs::CONTROL);
+	ControlTemp = ControlTemp & ~MCP79412Regs::EXTOSC; //Clear EXTOSC bit to enable and external oscilator 
+	uint8_t SecTemp = readByte(MCP79412Regs::RTCSEC); //Read value from seconds register to use as mask
+	SecTemp = SecTemp | MCP79412Regs::ST; //Set ST bit to start oscilator
+	int Error = writeByte(MCP79412Regs::CONTROL, ControlTemp); //Write back value of temp control register
+	if(Error != 0) return Error;
+	return writeByte(MCP79412Regs::RTCSEC, SecTemp); //Write back value of seconds register (for ST bit)
+}
+
+/**
+ * Set the digital trim (OSCTRIM). Each step adds (positive) or removes (negative) 2 oscillator clocks per minute, 
+ * about 1.017ppm. The trim is retained on VBAT, if the journal is enabled it is also recorded there (only when changed)
+ * so begin() can restore it after total power loss
+ *
+ * @param Steps, the trim (-127~127), positive to correct a slow clock
+ * @return int, the I2C status value (if any error occours), -1 if out of range
+ */
+int MCP79412::setTrim(int8_t Steps)
+{
+	if(Steps < -127) return -1;
+	uint8_t Val = Steps >= 0 ? (0x80 | Steps) : -Steps; //Sign and magnitude, SIGN = 1 adds clocks
+	if(Steps == 0) Val = 0;
+	int Error = writeByte(MCP79412Regs::OSCTRIM, Val);
+	#if defined(MCP79412_LEAN)
+	return Error; //No journal, trim is lost along with VBAT
+	#else
+	if(Error != 0 || journalSlots == 0) return Error;
+	uint32_t Stored = 0;
+	if(readJournal(JOURNAL_TYPE_TRIM, Stored) == 0 && Stored == Val) return 0;
+	return appendJournal(JOURNAL_TYPE_TRIM, Val);
+	#endif
+}
+
+/**
+ * Read the digital trim (OSCTRIM), served from the register cache if enabled
+ *
+ * @param Steps, set to the trim, positive if clocks are being added
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::getTrim(int8_t &Steps)
+{
+	uint8_t Val = 0;
+	int Slot = cacheSlot(MCP79412Regs::OSCTRIM);
+	if(Slot >= 0 && (cacheValid & (1 << Slot))) Val = cache[Slot];
+	else {
+		int Error = bus->read(ADR, MCP79412Regs::OSCTRIM, &Val, 1);
+		if(Error != 0) return Error;
+		cacheStore(MCP79412Regs::OSCTRIM, Val);
+	}
+	Steps = (Val & 0x80) ? (Val & 0x7F) : -(int8_t)(Val & 0x7F);
+	return 0;
+}
+
+/**
+ * Turn coarse trim mode (CRSTRIM) on or off. In coarse mode the trim is applied 128 times a second instead of 
+ * once a minute, which makes its effect visible on the MFP output within a second. Use only while measuring
+ *
+ * @param State, true for coarse trim
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::setCoarseTrim(bool State)
+{
+	return updateBits(MCP79412Regs::CONTROL, MCP79412Regs::CRSTRIM, State ? MCP79412Regs::CRSTRIM : 0x00);
+}
+
+#if !defined(MCP79412_LEAN)
+/**
+ * Record a calibration point, the RTC time and a trusted reference time (cloud or GPS sync) taken at the same instant. 
+ * If the clock is set to the reference after a point is taken (setTime()) the offset is carried forward, so points can 
+ * be collected at every sync. Points are only valid for the trim they were taken with, calibrateTrim() clears them
+ *
+ * @param RtcMs, RTC time [ms], e.g. getTimeMillis() with an aligned anchor
+ * @param RefMs, reference time [ms]
+ * @return int, number of points held, -1 if the offset is unreasonable (over 24 days)
+ */
+int MCP79412::addCalibrationPoint(int64_t RtcMs, int64_t RefMs)
+{
+	int64_t Offset = RtcMs - RefMs + calBias;
+	if(Offset > INT32_MAX || Offset < INT32_MIN) return -1;
+	calPoints[calHead].ref = RefMs;
+	calPoints[calHead].offset = (int32_t)Offset;
+	calHead = (calHead + 1) % CAL_MAX_POINTS;
+	if(calCount < CAL_MAX_POINTS) calCount++;
+	return calCount;
+}
+
+/**
+ * Estimate the drift of the RTC from the calibration points, least-squares fit of offset against reference time
+ *
+ * @param Ppm, set to the drift [ppm], positive if the RTC runs fast
+ * @return int, 0 if estimated, -1 if fewer than 2 points or all points at the same time
+ */
+int MCP79412::estimateDrift(float &Ppm)
+{
+	if(calCount < 2) return -1;
+	const int64_t Ref0 = calPoints[0].ref; //Work relative to one point to keep precision
+	double MeanX = 0;
+	double MeanY = 0;
+	for(uint8_t i = 0; i < calCount; i++) {
+		MeanX += (double)(calPoints[i].ref - Ref0);
+		MeanY += calPoints[i].offset;
+	}
+	MeanX /= calCount;
+	MeanY /= calCount;
+	double Sxx = 0;
+	double Sxy = 0;
+	for(uint8_t i = 0; i < calCount; i++) {
+		double X = (double)(calPoints[i].ref - Ref0) - MeanX;
+		Sxx += X*X;
+		Sxy += X*(calPoints[i].offset - MeanY);
+	}
+	if(Sxx <= 0) return -1;
+	Ppm = (float)(Sxy/Sxx*1e6);
+	return 0;
+}
+
+/**
+ * Fit the calibration points and correct the trim by the measured drift, the points are then cleared since they 
+ * were measured with the old trim
+ *
+ * @param MinSpan, minimum time covered by the points [s]. A point is only good to 1 s if the RTC time was read without 
+ * an aligned anchor, which is 11.6 ppm over a day but 1.7 ppm (under 2 trim steps) over the default week
+ * @return int, the I2C status value (if any error occours), -1 if there is not enough data
+ */
+int MCP79412::calibrateTrim(uint32_t MinSpan)
+{
+	float Ppm = 0;
+	if(estimateDrift(Ppm) != 0) return -1;
+	int64_t First = calPoints[0].ref;
+	int64_t Last = calPoints[0].ref;
+	for(uint8_t i = 1; i < calCount; i++) {
+		if(calPoints[i].ref < First) First = calPoints[i].ref;
+		if(calPoints[i].ref > Last) Last = calPoints[i].ref;
+	}
+	if(Last - First < (int64_t)MinSpan*1000) return -1;
+	int8_t Current = 0;
+	int Error = getTrim(Current);
+	if(Error != 0) return Error;
+	float Steps = Current - Ppm/TRIM_PPM_PER_STEP; //Fast clock needs clocks removed
+	if(Steps > 127) Steps = 127;
+	if(Steps < -127) Steps = -127;
+	Error = setTrim((int8_t)(Steps < 0 ? Steps - 0.5f : Steps + 0.5f));
+	if(Error == 0) clearCalibration();
+	return Error;
+}
+#endif
+
+/**
+ * Read from the battery-backed SRAM (retained as long as VBAT is present), split into as few bursts as the bus allows
+ *
+ * @param Offset, location in SRAM to start reading (0~63)
+ * @param Data, where to place the data read
+ * @param Len, number of bytes to read
+ * @return int, the I2C status value (if any error occours), -1 if the range exceeds SRAM
+ */
+int MCP79412::readSram(uint8_t Offset, uint8_t *Data, size_t Len)
+{
+	if(Offset + Len > SRAM_SIZE) return -1;
+	if(Len == 0) return 0;
+	return bus->read(ADR, MCP79412Regs::SRAM + Offset, Data, Len);
+}
+
+/**
+ * Write to the battery-backed SRAM, split into as few bursts as the bus allows
+ *
+ * @param Offset, location in SRAM to start writing (0~63)
+ * @param Data, the data to write
+ * @param Len, number of bytes to write
+ * @return int, the I2C status value (if any error occours), -1 if the range exceeds SRAM
+ */
+int MCP79412::writeSram(uint8_t Offset, const uint8_t *Data, size_t Len)
+{
+	if(Offset + Len > SRAM_SIZE) return -1;
+	if(Len == 0) return 0;
+	return bus->write(ADR, MCP79412Regs::SRAM + Offset, Data, Len);
+}
+
+/**
+ * Read from the user EEPROM as a sequential burst. Waits for any async write in progress to finish first
+ *
+ * @param Addr, location in EEPROM to start reading (0~127)
+ * @param Data, where to place the data read
+ * @param Len, number of bytes to read
+ * @return int, the I2C status value (if any error occours), -1 if the range exceeds the user array
+ */
+int MCP79412::readEeprom(uint8_t Addr, uint8_t *Data, size_t Len)
+{
+	if(Addr + Len > EEPROM_SIZE) return -1;
+	if(Len == 0) return 0;
+	while(updateEeprom() == AsyncStatus::Busy); //Finish async write, EEPROM does not respond during write cycle
+	return bus->read(ADR_EEPROM, Addr, Data, Len);
+}
+
+/**
+ * Write to the user EEPROM. Data is split on the 8 byte page boundary, each page is written in one transfer and completion 
+ * of the write cycle is detected by ACK polling rather than a fixed delay. Blocks until the last page is committed
+ *
+ * @param Addr, location in EEPROM to start writing (0~127)
+ * @param Data, the data to write
+ * @param Len, number of bytes to write
+ * @return int, the I2C status value (if any error occours), -1 if the range exceeds the user array
+ */
+int MCP79412::writeEeprom(uint8_t Addr, const uint8_t *Data, size_t Len)
+{
+	int Error = writeEepromAsync(Addr, Data, Len);
+	if(Error != 0) return Error;
+	AsyncStatus Status = AsyncStatus::Busy;
+	while((Status = updateEeprom()) == AsyncStatus::Busy); //Spin through the page sequence
+	return Status == AsyncStatus::Done ? 0 : 2; //Report NACK if write cycle never completed
+}
+
+/**
+ * Start a write to the user EEPROM and return after the first page is sent. The remaining pages are written by 
+ * subsequent calls to updateEeprom(), so the 5ms write cycle of each page does not block the caller
+ *
+ * @param Addr, location in EEPROM to start writing (0~127)
+ * @param Data, the data to write, must remain valid until the write is complete
+ * @param Len, number of bytes to write
+ * @return int, the I2C status value of the first page (if any error occours), -1 if the range exceeds the user array
+ */
+int MCP79412::writeEepromAsync(uint8_t Addr, const uint8_t *Data, size_t Len)
+{
+	if(Addr + Len > EEPROM_SIZE) return -1;
+	while(updateEeprom() == AsyncStatus::Busy); //Only one write in flight at a time
+	if(Len == 0) return 0;
+	eepromData = Data;
+	eepromAddr = Addr;
+	eepromRemaining = Len;
+	eepromFailed = false;
+	MCP79412Bus::Guard Lock(*bus); //No other EEPROM write may start between ACK and page
+	if(waitEeprom() != 0) { //Make sure no write cycle from elsewhere is still running
+		eepromData = NULL;
+		eepromFailed = true;
+		return 2;
+	}
+	return writeEepromPage();
+}
+
+/**
+ * Advance an async EEPROM write, checks (one address-only transfer) if the current page write cycle has finished and if so 
+ * sends the next page
+ *
+ * @return AsyncStatus, Busy while pages remain, Done once the last write cycle completes, Failed if a write or write cycle failed
+ */
+MCP79412::AsyncStatus MCP79412::updateEeprom()
+{
+	if(eepromData == NULL) return eepromFailed ? AsyncStatus::Failed : AsyncStatus::Done;
+	MCP79412Bus::Guard Lock(*bus); //Held for one poll and page, not the write cycle
+	if(bus->probe(ADR_EEPROM) != 0) { //Still in write cycle
+		if((millis() - eepromStarted) <= EEPROM_WRITE_TIMEOUT) return AsyncStatus::Busy;
+		eepromData = NULL; //Write cycle never completed, give up
+		eepromFailed = true;
+		return AsyncStatus::Failed;
+	}
+	if(eepromRemaining == 0) {
+		eepromData = NULL;
+		return AsyncStatus::Done;
+	}
+	return writeEepromPage() == 0 ? AsyncStatus::Busy : AsyncStatus::Failed;
+}
+
+/**
+ * Helper function, writes as much of the pending async data as fits in the current page
+ *
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::writeEepromPage()
+{
+	uint8_t n = EEPROM_PAGE - (eepromAddr % EEPROM_PAGE); //Room left in page
+	if(n > eepromRemaining) n = eepromRemaining;
+	int Error = bus->write(ADR_EEPROM, eepromAddr, eepromData, n);
+	eepromStarted = millis();
+	if(Error != 0) {
+		eepromData = NULL;
+		eepromFailed = true;
+		return Error;
+	}
+	eepromData += n;
+	eepromAddr += n;
+	eepromRemaining -= n;
+	return 0;
+}
+
+/**
+ * Helper function, ACK polls the EEPROM until any write cycle in progress has finished 
+ *
+ * @return int, 0 once the EEPROM acknowledges, 2 (NACK) if it does not within the write cycle timeout
+ */
+int MCP79412::waitEeprom()
+{
+	uint32_t Start = millis();
+	while(bus->probe(ADR_EEPROM) != 0) {
+		if((millis() - Start) > EEPROM_WRITE_TIMEOUT) return 2;
+	}
+	return 0;
+}
+
+#if !defined(MCP79412_LEAN)
+/**
+ * Configure a wear-leveled journal in the user EEPROM. Records (type + 32 bit value) are appended round robin, one page 
+ * per record, with a sequence number and CRC, so repeated updates are spread across the whole region. The newest record 
+ * of each type is carried forward when its slot is about to be reused, so the region must have more slots than record types 
+ *
+ * @param Start, first EEPROM address of the journal, must be page aligned
+ * @param Slots, number of 8 byte records in the journal (2~16)
+ * @return int, 0 if configured, -1 if the region is invalid
+ */
+int MCP79412::enableJournal(uint8_t Start, uint8_t Slots)
+{
+	if(Start % EEPROM_PAGE != 0 || Slots < 2 || Slots > JOURNAL_MAX_SLOTS || Start + Slots*EEPROM_PAGE > EEPROM_SIZE) return -1;
+	journalStart = Start;
+	journalSlots = Slots;
+	journalHead = 0;
+	journalSeq = 1;
+	memset(journalTypes, 0xFF, sizeof(journalTypes));
+	return 0;
+}
+
+/**
+ * Scan the journal in one sequential read and locate the newest valid record, called by begin()
+ *
+ * @return int, the I2C status value (if any error occours), -1 if the journal is not enabled
+ */
+int MCP79412::recoverJournal()
+{
+	if(journalSlots == 0) return -1;
+	uint8_t Region[EEPROM_SIZE];
+	int Error = readEeprom(journalStart, Region, journalSlots*EEPROM_PAGE);
+	if(Error != 0) return Error;
+	int Newest = -1;
+	uint16_t NewestSeq = 0;
+	for(int i = 0; i < journalSlots; i++) {
+		const uint8_t *Rec = Region + i*EEPROM_PAGE; //Seq (2, LE), type, value (4, LE), CRC
+		uint16_t Seq = Rec[0] | (Rec[1] << 8);
+		journalTypes[i] = 0xFF;
+		if(Rec[2] == 0xFF || crc8(Rec, EEPROM_PAGE - 1) != Rec[EEPROM_PAGE - 1]) continue; //Blank or torn record
+		journalTypes[i] = Rec[2];
+		if(Newest < 0 || (int16_t)(Seq - NewestSeq) > 0) { //Sequence compared with wrap around
+			Newest = i;
+			NewestSeq = Seq;
+		}
+	}
+	journalHead = Newest < 0 ? 0 : (Newest + 1) % journalSlots;
+	journalSeq = Newest < 0 ? 1 : NewestSeq + 1;
+	return 0;
+}
+
+/**
+ * Append a record to the journal, one page write. If the slot to be overwritten holds the only copy of another type, that 
+ * record is first carried forward to the head so it is never lost
+ *
+ * @param Type, record type (0~254)
+ * @param Value, the value to store
+ * @return int, the I2C status value (if any error occours), -1 if the journal is not enabled or type is invalid, -2 if the journal is full of distinct types
+ */
+int MCP79412::appendJournal(uint8_t Type, uint32_t Value)
+{
+	if(journalSlots == 0 || Type == 0xFF) return -1;
+	bool Room = false; //A slot can be reused if it is empty, holds this type or holds a type with another copy
+	for(int i = 0; i < journalSlots && !Room; i++) {
+		if(journalTypes[i] == 0xFF || journalTypes[i] == Type) Room = true;
+		for(int j = i + 1; j < journalSlots && !Room; j++) {
+			if(journalTypes[j] == journalTypes[i]) Room = true;
+		}
+	}
+	if(!Room) return -2; //Every slot holds a different type, nothing written
+	for(int Moves = 0; Moves < journalSlots; Moves++) {
+		uint8_t Victim = journalTypes[journalHead];
+		bool Unique = (Victim != 0xFF && Victim != Type);
+		for(int i = 0; i < journalSlots && Unique; i++) {
+			if(i != journalHead && journalTypes[i] == Victim) Unique = false; //Another copy survives
+		}
+		if(!Unique) return writeJournalRecord(Type, Value);
+		uint32_t Carry = 0; //Move the only copy of victim type forward before its slot is reused
+		int Error = readJournal(Victim, Carry);
+		if(Error != 0) return Error;
+		Error = writeJournalRecord(Victim, Carry);
+		if(Error != 0) return Error;
+	}
+	return -2; //Every slot holds a different type
+}
+
+/**
+ * Read the newest value of a given type from the journal, one 8 byte read
+ *
+ * @param Type, record type to look for
+ * @param Value, set to the stored value if found
+ * @return int, the I2C status value (if any error occours), -1 if the journal is not enabled, -2 if no valid record of this type exists
+ */
+int MCP79412::readJournal(uint8_t Type, uint32_t &Value)
+{
+	if(journalSlots == 0) return -1;
+	for(int n = 1; n <= journalSlots; n++) { //Walk backward from the newest record
+		uint8_t Slot = (journalHead + journalSlots - n) % journalSlots;
+		if(journalTypes[Slot] != Type) continue;
+		uint8_t Rec[EEPROM_PAGE];
+		int Error = readEeprom(journalStart + Slot*EEPROM_PAGE, Rec, sizeof(Rec));
+		if(Error != 0) return Error;
+		if(Rec[2] != Type || crc8(Rec, EEPROM_PAGE - 1) != Rec[EEPROM_PAGE - 1]) {
+			journalTypes[Slot] = 0xFF; //Record has gone bad, try older copy
+			continue;
+		}
+		Value = Rec[3] | ((uint32_t)Rec[4] << 8) | ((uint32_t)Rec[5] << 16) | ((uint32_t)Rec[6] << 24);
+		return 0;
+	}
+	return -2;
+}
+
+/**
+ * Helper function, writes a record at the journal head and advances it
+ *
+ * @param Type, record type
+ * @param Value, the value to store
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::writeJournalRecord(uint8_t Type, uint32_t Value)
+{
+	uint8_t Rec[EEPROM_PAGE] = {(uint8_t)journalSeq, (uint8_t)(journalSeq >> 8), Type, 
+		(uint8_t)Value, (uint8_t)(Value >> 8), (uint8_t)(Value >> 16), (uint8_t)(Value >> 24), 0};
+	Rec[EEPROM_PAGE - 1] = crc8(Rec, EEPROM_PAGE - 1);
+	int Error = writeEeprom(journalStart + journalHead*EEPROM_PAGE, Rec, sizeof(Rec));
+	if(Error != 0) {
+		journalTypes[journalHead] = 0xFF; //Slot contents unknown
+		return Error;
+	}
+	journalTypes[journalHead] = Type;
+	journalHead = (journalHead + 1) % journalSlots;
+	journalSeq++;
+	return 0;
+}
+#endif
+
+/**
+ * CRC-8 (polynomial 0x31), used to validate data held in SRAM and EEPROM. Default seed of 0xFF makes blank (all zero) memory fail
+ *
+ * @param Data, the data to check 
+ * @param Len, number of bytes
+ * @param Crc, initial value, or result of previous call to continue a calculation
+ * @return uint8_t, the CRC
+ */
+uint8_t MCP79412::crc8(const uint8_t *Data, size_t Len, uint8_t Crc)
+{
+	for(size_t i = 0; i < Len; i++) {
+		Crc ^= Data[i];
+		for(int b = 0; b < 8; b++) {
+			Crc = (Crc & 0x80) ? (uint8_t)((Crc << 1) ^ 0x31) : (uint8_t)(Crc << 1);
+		}
+	}
+	return Crc;
+}
+
+/**
+ * Helper function, reads byte and given register location
+ *
+ * @param Reg, the register to read the byte from 
+ * @return uint8_t, returns the desired byte
+ */
+uint8_t MCP79412::readByte(int Reg)
+{
+	int Slot = cacheSlot(Reg);
+	if(Slot >= 0 && CacheMask[Slot] == 0xFF && (cacheValid & (1 << Slot))) return cache[Slot]; //Whole register is held in cache
+	uint8_t Val = 0;
+	if(bus->read(ADR, Reg, &Val, 1) == 0) { //If got byte, return value
+		cacheStore(Reg, Val);
+		return Val; 
+	}
+	else return 0; //Otherwise return zero 
+}
+
+/**
+ * Helper function, write value (byte) to register at given register location
+ *
+ * @param Reg, the location of the register to write the data to
+ * @param Val, the value of the data to write to the register 
+ * @return int, I2C status
+ */
+int MCP79412::writeByte(int Reg, uint8_t Val)
+{
+	invalidateSnapshot(); //CONTROL, OSCTRIM, alarm and status bits are all written through here
+	int Error = bus->write(ADR, Reg, &Val, 1);
+	if(Error == 0) cacheStore(Reg, Val); //Write-through
+	else {
+		int Slot = cacheSlot(Reg);
+		if(Slot >= 0) cacheValid &= ~(1 << Slot); //Register state unknown after failed write
+	}
+	return Error; //Return I2C status 
+}
+
+/**
+ * Helper function, reads bit value from given byte and retuns this as bool
+ *
+ * @param Reg, the location of the register to read the data from
+ * @param Pos, the position of the bit to return
+ * @return bool, the value of the bit at the ith location 
+ */
+bool MCP79412::readBit(int Reg, uint8_t Pos)
+{
+	int Slot = cacheSlot(Reg);
+	if(Slot >= 0 && (CacheMask[Slot] & (1 << Pos)) && (cacheValid & (1 << Slot))) return (cache[Slot] >> Pos) & 0x01; //Served from cache
+	uint8_t Val = readByte(Reg);
+	return (Val >> Pos) & 0x01; //Return single reguested bit
+}
+
+/**
+ * Helper function, sets a bit at a given location in a register 
+ *
+ * @param Reg, the location of the register to set the bit in
+ * @param Pos, the position of the bit to set
+ * @return int, I2C status 
+ */
+int MCP79412::setBit(int Reg, uint8_t Pos)
+{
+	return updateBits(Reg, 0, 1 << Pos); //Set desired bit
+}
+
+/**
+ * Helper function, clears a bit at a given location in a register 
+ *
+ * @param Reg, the location of the register to clear the bit in
+ * @param Pos, the position of the bit to clear
+ * @return int, I2C status 
+ */
+int MCP79412::clearBit(int Reg, uint8_t Pos)
+{
+	return updateBits(Reg, 1 << Pos, 0); //Clear desired bit
+}
+
+/**
+ * Helper function, clears and sets bits of a register in a single read-modify-write. If the whole register
+ * is held in the shadow cache the read is skipped and only the write is issued
+ *
+ * @param Reg, the location of the register to modify
+ * @param Clear, mask of bits to clear
+ * @param Set, mask of bits to set (applied after clear)
+ * @return int, I2C status 
+ */
+int MCP79412::updateBits(int Reg, uint8_t Clear, uint8_t Set)
+{
+	uint8_t ValTemp = 0;
+	MCP79412Bus::Guard Lock(*bus);
+	int Slot = cacheSlot(Reg);
+	if(Slot >= 0 && CacheMask[Slot] == 0xFF && (cacheValid & (1 << Slot))) ValTemp = cache[Slot];
+	else {
+		int Error = bus->read(ADR, Reg, &ValTemp, 1); //Grab register
+		if(Error != 0) return Error; //Do not write back an unknown value
+	}
+	ValTemp = (ValTemp & ~Clear) | Set;
+	return writeByte(Reg, ValTemp); //Write value back in place
+}
+
+/**
+ * Turns the shadow register cache on or off. When on, CONTROL and OSCTRIM are served entirely from RAM after 
+ * the first access and the ALMxWKDAY mask/polarity/day bits are cached for reads. The alarm flags are always read 
+ * from the device. Only use when no other master modifies these registers 
+ *
+ * @param State, true to enable the cache, false to disable (cache contents are discarded in both cases)
+ */
+void MCP79412::enableRegisterCache(bool State)
+{
+	cacheEnabled = State;
+	cacheValid = 0;
+}
 
-   tz = getenv("TZ");
-    setenv("TZ", "", 1);
-    tzset();
-    ret = mktime(tm);
-    if (tz)
-        setenv("TZ", tz, 1);
-    else
-        unsetenv("TZ");
-    tzset();
-    return ret;
+/**
+ * Mark all cached registers as stale, next access of each will be read from the device
+ */
+void MCP79412::invalidateCache()
+{
+	cacheValid = 0;
+}
+
+/**
+ * Reload all cached registers from the device in a single burst read (0x07~0x14)
+ *
+ * @return int, I2C status, -1 if the cache is not enabled
+ */
+int MCP79412::syncCache()
+{
+	if(!cacheEnabled) return -1;
+	uint8_t Block[MCP79412Regs::Alarm<1>::WKDAY - MCP79412Regs::CONTROL + 1] = {0};
+	cacheValid = 0;
+	int Error = bus->read(ADR, MCP79412Regs::CONTROL, Block, sizeof(Block));
+	if(Error != 0) return Error;
+	for(int i = 0; i < CACHE_SIZE; i++) {
+		cacheStore(CacheRegs[i], Block[CacheRegs[i] - MCP79412Regs::CONTROL]);
+	}
+	return 0;
+}
+
+/**
+ * Helper function, finds the cache slot used for a register
+ *
+ * @param Reg, the register address
+ * @return int, slot index, -1 if the register is not cached (or cache is off)
+ */
+int MCP79412::cacheSlot(int Reg)
+{
+	if(!cacheEnabled) return -1;
+	for(int i = 0; i < CACHE_SIZE; i++) {
+		if(CacheRegs[i] == Reg) return i;
+	}
+	return -1;
+}
+
+/**
+ * Helper function, records a value known to be in a register
+ *
+ * @param Reg, the register address
+ * @param Val, the value read from or written to the register 
+ */
+void MCP79412::cacheStore(int Reg, uint8_t Val)
+{
+	int Slot = cacheSlot(Reg);
+	if(Slot < 0) return;
+	cache[Slot] = Val & CacheMask[Slot];
+	cacheValid |= 1 << Slot;
+	if(Slot >= 2) { //ALMPOL (bit 7) is mirrored by hardware between ALM0WKDAY and ALM1WKDAY
+		int Other = Slot == 2 ? 3 : 2;
+		cache[Other] = (cache[Other] & ~MCP79412Regs::ALMPOL) | (Val & MCP79412Regs::ALMPOL);
+	}
+}
+
+#if defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'
+	#define MCP79412_DETECT_ISR 1
+/**
+ * Helper function, true when running in an interrupt handler (Cortex-M IPSR holds the active exception number)
+ */
+static inline bool inInterrupt()
+{
+	uint32_t Ipsr = 0;
+	__asm__ volatile("mrs %0, ipsr" : "=r"(Ipsr));
+	return Ipsr != 0;
+}
+#elif !defined(PARTICLE) && !defined(ARDUINO)
+	#define MCP79412_DETECT_ISR 1
+static inline bool inInterrupt() {return false;} //Host, no interrupts
+#endif
+
+static void collectError(const MCP79412::ErrorRecord &Record, void *Context)
+{
+	uint32_t **Out = (uint32_t**)Context;
+	*((*Out)++) = Record.code;
+}
+
+/**
+ * Reports the current array of errors, each distinct code is reported once no matter how often it was thrown
+ * 
+ * @param errors, array of errors to pass out, must hold MAX_NUM_ERRORS values
+ * @return uint8_t, number of errors reported plus the number of codes dropped, Note: can exceed MAX_NUM_ERRORS, in this case an overrun has occoured 
+ */
+uint8_t MCP79412::getErrorsArray(uint32_t errors_[]) 
+{
+	uint32_t *Out = errors_;
+	uint16_t Total = drainErrors(collectError, &Out);
+	Total += takeDroppedErrors();
+	return Total > 0xFF ? 0xFF : Total;
+}
+
+/**
+ * Adds the specified error to the queue of errors. If the code is already queued its occurrence count and last 
+ * timestamp are updated instead, so a repeating fault only ever occupies one slot. Lock-free, safe to call from an ISR.
+ * With the SRAM log enabled the copy is updated here when not in an ISR, which can only be detected on Cortex-M (and 
+ * host builds). On other targets the bus is never touched here, call flushErrors() from the main loop instead
+ * 
+ * @param errors, new error value to write add to the queue
+ * @return int, current number of distinct errors queued
+ */
+int MCP79412::throwError(uint32_t error)
+{
+	pushError(error, millis());
+	if(errorSramOffset >= 0) {
+		#if defined(MCP79412_DETECT_ISR)
+		if(!inInterrupt()) persistErrors(); //Keep SRAM copy so error survives reset, bus is not touched from an ISR
+		else errorsDirty.store(true, std::memory_order_release);
+		#else
+		errorsDirty.store(true, std::memory_order_release); //May be in an ISR, leave the bus to flushErrors()
+		#endif
+	}
+	return pendingErrors();
+}
+
+/**
+ * Bring the SRAM error log up to date with errors thrown where the bus could not be used (from an ISR, or anywhere
+ * on targets where an ISR can not be detected). Call from the main loop, not from an ISR
+ * 
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::flushErrors()
+{
+	if(errorSramOffset < 0 || !errorsDirty.load(std::memory_order_acquire)) return 0;
+	int Error = persistErrors();
+	if(Error != 0) errorsDirty.store(true, std::memory_order_release); //Try again next time
+	return Error;
+}
+
+/**
+ * Helper function, queues an error raised by the driver itself, which never runs in an ISR
+ * 
+ * @param Code, the error code
+ */
+void MCP79412::logError(uint32_t Code)
+{
+	pushError(Code, millis());
+	if(errorSramOffset >= 0) persistErrors();
+}
+
+/**
+ * Removes all queued errors, oldest first, handing each to a visitor as it is removed. Single consumer, do not call 
+ * from more than one thread at a time
+ * 
+ * @param Visit, called once per distinct error, may be NULL to discard
+ * @param Context, passed through to Visit
+ * @return uint8_t, number of errors removed
+ */
+uint8_t MCP79412::drainErrors(ErrorVisitor Visit, void *Context)
+{
+	uint8_t Tail = errorTail.load(std::memory_order_relaxed);
+	const uint8_t Head = errorHead.load(std::memory_order_acquire);
+	uint8_t Drained = 0;
+	while(Tail != Head) {
+		ErrorSlot &Slot = errorQueue[Tail % ERROR_QUEUE_SIZE];
+		uint16_t Count = Slot.count.exchange(0, std::memory_order_acq_rel); //Take the slot, producers stop coalescing into it
+		if(Count == 0) break; //Producer was interrupted while filling this slot, pick it up on the next drain
+		ErrorRecord Record = {Slot.code, Count, Slot.first, Slot.last.load(std::memory_order_relaxed)};
+		Tail = (Tail + 1) % ERROR_INDEX_WRAP;
+		errorTail.store(Tail, std::memory_order_release); //Release the slot before the visitor runs, it may throw errors itself
+		if(Visit != NULL) Visit(Record, Context);
+		Drained++;
+	}
+	if(Drained > 0 && errorSramOffset >= 0) persistErrors(); //Clear persistent copy
+	return Drained;
+}
+
+/**
+ * Number of errors discarded because the queue was full (new codes only, repeats of queued codes are always counted)
+ * 
+ * @return uint16_t, dropped errors since the last call, counter is cleared
+ */
+uint16_t MCP79412::takeDroppedErrors()
+{
+	return errorsDropped.exchange(0, std::memory_order_relaxed);
+}
+
+/**
+ * Helper function, coalesces an error into the queue or reserves a new slot for it
+ * 
+ * @param Code, the error code
+ * @param Now, millis() at time of the error
+ */
+void MCP79412::pushError(uint32_t Code, uint32_t Now)
+{
+	uint8_t Tail = errorTail.load(std::memory_order_acquire);
+	uint8_t Head = errorHead.load(std::memory_order_acquire);
+	for(uint8_t i = Tail; i != Head; i = (i + 1) % ERROR_INDEX_WRAP) { //Look for a pending report of the same code
+		ErrorSlot &Slot = errorQueue[i % ERROR_QUEUE_SIZE];
+		uint16_t Count = Slot.count.load(std::memory_order_acquire);
+		while(Count != 0 && Slot.code == Code) { //Only count a slot which is published and not yet taken by the consumer
+			if(Count == 0xFFFF || Slot.count.compare_exchange_weak(Count, Count + 1, std::memory_order_acq_rel)) {
+				Slot.last.store(Now, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	do { //Reserve a slot, an ISR may reserve between our load and exchange
+		Tail = errorTail.load(std::memory_order_acquire);
+		if((Head + ERROR_INDEX_WRAP - Tail) % ERROR_INDEX_WRAP >= MAX_NUM_ERRORS) { //Full, keep the errors already queued
+			uint16_t Dropped = errorsDropped.load(std::memory_order_relaxed);
+			while(Dropped != 0xFFFF && !errorsDropped.compare_exchange_weak(Dropped, Dropped + 1, std::memory_order_relaxed));
+			return;
+		}
+	} while(!errorHead.compare_exchange_weak(Head, (Head + 1) % ERROR_INDEX_WRAP, std::memory_order_acq_rel));
+
+	ErrorSlot &Slot = errorQueue[Head % ERROR_QUEUE_SIZE];
+	Slot.code = Code;
+	Slot.first = Now;
+	Slot.last.store(Now, std::memory_order_relaxed);
+	Slot.count.store(1, std::memory_order_release); //Publish
+}
+
+/**
+ * Helper function, number of distinct errors currently queued
+ */
+uint8_t MCP79412::pendingErrors() const
+{
+	return (errorHead.load(std::memory_order_acquire) + ERROR_INDEX_WRAP - errorTail.load(std::memory_order_acquire)) % ERROR_INDEX_WRAP;
+}
+
+/**
+ * Keep a copy of the error queue in battery-backed SRAM so errors survive reset and deep sleep (as long as VBAT is present). 
+ * Any errors found from before the reset are queued behind the errors already thrown this session. The copy is refreshed
+ * on every throwError() outside of an ISR and on every drain. Can be called before begin()
+ * 
+ * @param Offset, location in SRAM (0~63) for the ring
+ * @param Slots, number of errors held (1~MAX_NUM_ERRORS), ring occupies 3 + 4*Slots bytes
+ * @return int, the I2C status value (if any error occours), -1 if the ring does not fit in SRAM
+ */
+int MCP79412::enableSramErrorLog(uint8_t Offset, uint8_t Slots)
+{
+	#if MCP79412_MAX_ERRORS == 0
+	(void)Offset;
+	(void)Slots;
+	return -1; //No error queue to keep
+	#else
+	if(Slots == 0 || Slots > MAX_NUM_ERRORS || Offset + 3 + 4*Slots > SRAM_SIZE) return -1;
+	bus->begin(); //May be called before begin()
+	MCP79412Bus::Guard Lock(*bus);
+	uint8_t Region[3 + 4*MAX_NUM_ERRORS] = {0};
+	size_t Len = 3 + 4*Slots;
+	int Error = readSram(Offset, Region, Len);
+	if(Error != 0) return Error;
+
+	errorSlots = Slots;
+	if(Region[0] == ERROR_LOG_MAGIC && Region[1] <= Slots && crc8(Region + 3, Len - 3, crc8(Region, 2)) == Region[2]) { //Valid ring from before reset
+		uint32_t Now = millis();
+		for(int i = 0; i < Region[1]; i++) {
+			const uint8_t *Code = Region + 3 + 4*i;
+			pushError(Code[0] | ((uint32_t)Code[1] << 8) | ((uint32_t)Code[2] << 16) | ((uint32_t)Code[3] << 24), Now);
+		}
+	}
+	errorSramOffset = Offset;
+	return persistErrors();
+	#endif
+}
+
+/**
+ * Helper function, writes the oldest queued codes (up to errorSlots) to SRAM as a single burst
+ * 
+ * @return int, the I2C status value (if any error occours)
+ */
+int MCP79412::persistErrors()
+{
+	#if MCP79412_MAX_ERRORS == 0
+	return -1; //Never enabled, see enableSramErrorLog()
+	#else
+	errorsDirty.store(false, std::memory_order_relaxed); //Errors thrown from here on set it again
+	uint8_t Region[3 + 4*MAX_NUM_ERRORS] = {ERROR_LOG_MAGIC, 0, 0}; //Magic, count, CRC, codes
+	size_t Len = 3 + 4*errorSlots;
+	const uint8_t Head = errorHead.load(std::memory_order_acquire);
+	for(uint8_t i = errorTail.load(std::memory_order_acquire); i != Head && Region[1] < errorSlots; i = (i + 1) % ERROR_INDEX_WRAP) {
+		const ErrorSlot &Slot = errorQueue[i % ERROR_QUEUE_SIZE];
+		if(Slot.count.load(std::memory_order_acquire) == 0) continue; //Being filled or already drained
+		uint8_t *Code = Region + 3 + 4*Region[1]++;
+		Code[0] = Slot.code;
+		Code[1] = Slot.code >> 8;
+		Code[2] = Slot.code >> 16;
+		Code[3] = Slot.code >> 24;
+	}
+	Region[2] = crc8(Region + 3, Len - 3, crc8(Region, 2));
+	return writeSram(errorSramOffset, Region, Len);
+	#endif
+}
+
+/**
+ * Convert calendar time (UTC) to Unix time using integer arithmetic only, no libc time zone handling
+ *
+ * @param t, the time to convert, wday is ignored
+ * @return time_t, seconds since the Unix epoch
+ */
+time_t MCP79412::toUnix(const Timestamp &t)
+{
+	return (time_t)daysFromCivil(t.year, t.month, t.mday)*86400 + t.hour*3600 + t.min*60 + t.sec; //Convert days since epoch to seconds, sum partial seconds from the current day
 }
 
-time_t MCP79412::cstToUnix(int year, int month, int day, int hour, int minute, int second)
+/**
+ * Convert Unix time into calendar fields (proleptic Gregorian, UTC) using integer arithmetic only. Day of week is counted from Monday (1~7)
+ *
+ * @param Time, seconds since the Unix epoch 
+ * @return Timestamp, the calendar representation 
+ */
+MCP79412::Timestamp MCP79412::fromUnix(time_t Time)
 {
-    unsigned long unixDate = day - 32075 + 1461*(year + 4800 + (month - 14)/12)/4 + 367*(month - 2 - (month - 14)/12*12)/12 - 3*((year + 4900 + (month - 14)/12)/100)/4 - 2440588; //Stolen from Communications of the ACM in October 1968 (Volume 11, Number 10), Henry F. Fliegel and Thomas C. Van Flandern - offset from Julian Date. Why mess with success? 
-    return unixDate*86400 + hour*3600 + minute*60 + second; //Convert unixDate to seconds, sum partial seconds from the current day
+	int32_t Days = (int32_t)(Time / 86400);
+	int32_t Secs = (int32_t)(Time % 86400);
+	if(Secs < 0) {
+		Secs += 86400;
+		Days--;
+	}
+	Civil Date = civilFromDays(Days);
+	Timestamp ts;
+	ts.year = (uint16_t)Date.year;
+	ts.month = Date.month;
+	ts.mday = Date.day;
+	ts.wday = dayOfWeek(Days);
+	ts.hour = Secs / 3600;
+	ts.min = (Secs / 60) % 60;
+	ts.sec = Secs % 60;
+	return ts;
+}
 
-}
\ No newline at end of file
+/**
+ * Helper function, returns the current time from the anchor if enabled, otherwise from the device
+ *
+ * @return Timestamp, the current time 
+ */
+MCP79412::Timestamp MCP79412::currentTime()
+{
+	#if !defined(MCP79412_LEAN)
+	if(anchorEnabled) return fromUnix(getTimeUnix());
+	#endif
+	return getRawTime();
+}
@@ -18,9 +18,35 @@ Distributed as-is; no warranty is given.
 #ifndef MCP79412_h
 #define MCP79412_h
 
-#include <Particle.h>
+#if !defined(MCP79412_MAX_ERRORS)
+	#if defined(MCP79412_LEAN)
+		#define MCP79412_MAX_ERRORS 0
+	#else
+		#define MCP79412_MAX_ERRORS 10
+	#endif
+#endif
+
+/*
+Build options, define before including (or on the compiler command line):
+
+	MCP79412_LEAN - Smallest footprint for small targets: no String API (use formatTime(), formatUUID()), errors are 
+		only counted (see takeDroppedErrors()) unless MCP79412_MAX_ERRORS is given. Leaves out the features which 
+		hold state in the instance: time anchor (getTimeMillis() reads the device), getValue() snapshot reuse, 
+		calibration fit (setTrim() remains), EEPROM journal, recurring alarms, and the alarm images which let 
+		rearmAlarm() write only the changed registers (it writes the whole block)
+	MCP79412_MAX_ERRORS - Distinct errors queued, 0 to keep no error buffer
+	MCP79412_RAM_BUDGET - Fail the build if sizeof(MCP79412) exceeds this many bytes
+
+Instance and per-function code size of each configuration are reported on the host by `make size` in extras/host
+*/
+
+#include "MCP79412_Bus.h"
+#include "MCP79412_Regs.h"
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+#include <atomic>
 // #include "Arduino.h"
 // #include <cstdint>
 // #ifdef ARDUINO 
@@ -62,11 +88,12 @@ Distributed as-is; no warranty is given.
 
 class MCP79412
 {
-    const uint32_t NONREAL_TIME = 0x500101F5; ///<RTC has been set to non-real time (day or month or year read as zero)
-    const uint32_t ANCIENT_TIME = 0x500201F5; ///<RTC has been set to time before start of 2000
-    const uint32_t RTC_EEPROM_READ_FAIL = 0x100800F5; ///<EEPROM failed to read
-	const uint32_t RTC_POWER_LOSS = 0x54B200F5; ///<When the bat en bit is set back to 0
-	constexpr static int MAX_NUM_ERRORS = 10; ///<Maximum number of errors to log before overwriting previous errors in buffer
+    constexpr static uint32_t NONREAL_TIME = 0x500101F5; ///<RTC has been set to non-real time (day or month or year read as zero)
+    constexpr static uint32_t ANCIENT_TIME = 0x500201F5; ///<RTC has been set to time before start of 2000
+    constexpr static uint32_t RTC_EEPROM_READ_FAIL = 0x100800F5; ///<EEPROM failed to read
+	constexpr static uint32_t RTC_POWER_LOSS = 0x54B200F5; ///<When the bat en bit is set back to 0
+	constexpr static int MAX_NUM_ERRORS = MCP79412_MAX_ERRORS; ///<Maximum number of errors to log before overwriting previous errors in buffer
+	static_assert(MAX_NUM_ERRORS >= 0 && MAX_NUM_ERRORS <= 100, "MCP79412_MAX_ERRORS must be 0~100");
 	public:
 		enum class Format: int
 		{
@@ -83,6 +110,15 @@ class MCP79412
 			Inverted = 1
 		};
 
+		enum class AsyncStatus: int //State of an operation completed in the background by repeated calls
+		{
+			Done = 0,
+			Busy = 1,
+			Failed = -1
+		};
+
+		constexpr static uint32_t OSC_START_TIMEOUT = 1000; ///<Default time allowed for the crystal to start, see beginAsync() [ms]
+
 		struct Timestamp {
 			uint16_t year;  // e.g. 2020
 			uint8_t  month; // 1-12
@@ -93,51 +129,393 @@ class MCP79412
 			uint8_t  sec;   // 0-59
 		};
 
-		MCP79412();
+		enum class AlarmMask: uint8_t //ALMxMSK values, which fields must match for the alarm to trigger
+		{
+			Seconds = 0,
+			Minutes = 1,
+			Hours = 2,
+			WeekDay = 3,
+			Date = 4,
+			Full = 7 //Seconds, minutes, hours, weekday, date and month
+		};
+
+		struct AlarmBlock { //Alarm staged in RAM, committed to ALM0 (0x0A~0x0F) or ALM1 (0x11~0x16) with commitAlarm()
+			uint8_t  month = 1; // 1-12
+			uint8_t  mday = 1;  // 1-31
+			uint8_t  wday = 1;  // 1-7
+			uint8_t  hour = 0;  // 0-23
+			uint8_t  min = 0;   // 0-59
+			uint8_t  sec = 0;   // 0-59
+			AlarmMask mask = AlarmMask::Full;
+
+			AlarmBlock& date(uint8_t Month, uint8_t Day) {month = Month; mday = Day; return *this;}
+			AlarmBlock& weekDay(uint8_t Day) {wday = Day; return *this;}
+			AlarmBlock& time(uint8_t Hour, uint8_t Min, uint8_t Sec) {hour = Hour; min = Min; sec = Sec; return *this;}
+			AlarmBlock& match(AlarmMask Mask) {mask = Mask; return *this;}
+			AlarmBlock& at(time_t Time, time_t Now = 0, uint8_t NowWDay = 0); //Full match at a Unix time, weekday counted from the RTC's weekday at Now if given
+		};
+
+		struct AlarmInfo { //Alarm as read back from the device, see getAlarm()
+			AlarmBlock block; //Match fields and mask
+			time_t next = 0; //Next Unix time the alarm will match, 0 if the block can never match
+			bool enabled = false;
+			bool flag = false; //ALMxIF, alarm has triggered and not been cleared
+		};
+
+		struct Outage { //Interval the device ran from VBAT (main power lost), from the power-fail stamps, see readOutage()
+			time_t down = 0; //Unix time main power was lost, stamps have no seconds so resolution is one minute
+			time_t up = 0; //Unix time main power was restored
+			uint32_t duration = 0; //up - down [s]
+			bool valid = false; //PWRFAIL was set, the stamps hold an outage
+		};
+
+		struct GroupSample { //Time read from one device of a group, see readTimeGroup()
+			time_t time = 0; //Unix time read from the device
+			uint32_t readAt = 0; //micros() at the middle of the transfer
+			int error = 0; //I2C status of the read
+		};
+
+		struct Snapshot { //Consistent image of the timekeeping, config, alarm and power-fail registers from a single burst read
+			uint8_t regs[MCP79412Regs::SRAM] = {0}; //Raw registers 0x00~0x1F
+			uint32_t captured = 0; //millis() at capture
+			bool valid = false;
+
+			Timestamp time() const;
+			time_t unixTime() const;
+			int value(int n) const; //Same indexing as getValue()
+			uint8_t control() const {return regs[MCP79412Regs::CONTROL];}
+			uint8_t trim() const {return regs[MCP79412Regs::OSCTRIM];} //Raw OSCTRIM, bit 7 is sign
+			bool oscRunning() const {return regs[MCP79412Regs::RTCWKDAY] & MCP79412Regs::OSCRUN;}
+			bool powerFail() const {return regs[MCP79412Regs::RTCWKDAY] & MCP79412Regs::PWRFAIL;}
+			bool batteryEnabled() const {return regs[MCP79412Regs::RTCWKDAY] & MCP79412Regs::VBATEN;}
+			bool alarmEnabled(bool AlarmVal = 0) const {return regs[MCP79412Regs::CONTROL] & alarmMap(AlarmVal).en;}
+			bool alarmFlag(bool AlarmVal = 0) const {return regs[alarmMap(AlarmVal).wkday] & MCP79412Regs::ALMIF;}
+			const uint8_t* alarmBlock(bool AlarmVal = 0) const {return regs + alarmMap(AlarmVal).sec;} //Seconds through month
+			const uint8_t* powerDown() const {return regs + MCP79412Regs::PWRDN;} //Minutes, hours, date, weekday/month
+			const uint8_t* powerUp() const {return regs + MCP79412Regs::PWRUP;}
+			bool outage(Outage &Out) const; //Decode the power-fail stamps, false if none are latched
+		};
+
+
+		#if defined(MCP79412_HAS_WIRE)
+		MCP79412(); //Use the default Wire port
+		#endif
+		explicit MCP79412(MCP79412Bus &Bus);
+		MCP79412(MCP79412Mux &Mux, uint8_t Channel); //Device behind an I2C mux
 		int begin(bool UseExtOsc = false);
+		int beginAsync(bool UseExtOsc = false, uint32_t Timeout = OSC_START_TIMEOUT);
+		AsyncStatus pollBegin(); //Call until not Busy after beginAsync()
 		int setTime(int Year, int Month, int Day, int DoW, int Hour, int Min, int Sec);
 		int setTime(int Year, int Month, int Day, int Hour, int Min, int Sec);
 		Timestamp getRawTime();
+		#if defined(MCP79412_HAS_STRING)
 		String getTime(Format mode = Format::Scientific); //Default to scientifc
+		#endif
+		int formatTime(char *Buffer, size_t Len, Format Mode = Format::Scientific); //Default to scientifc
+		static int formatTime(const Timestamp &t, char *Buffer, size_t Len, Format Mode = Format::Scientific);
 		time_t getTimeUnix(); 
+		static time_t toUnix(const Timestamp &t); //Pure arithmetic UTC conversion, replaces timegm
+		static int readTimeGroup(MCP79412 *const Devices[], size_t Count, GroupSample Samples[]); //Back-to-back reads for skew measurement
+		static Timestamp fromUnix(time_t Time);
+		uint64_t getTimeMillis(); //Unix time in ms, resolution depends on anchor alignment
+		#if !defined(MCP79412_LEAN)
+		int enableTimeAnchor(uint32_t Interval = 3600000, uint32_t DriftLimit = 1000); //Re-anchor hourly by default, tighten if drift > 1s
+		void disableTimeAnchor();
+		int syncAnchor(bool AlignToEdge = false);
+		uint32_t getAnchorAge(); //ms since last anchor
+		int32_t getAnchorDrift() {return anchorDrift;} //Error measured at last re-anchor [ms], positive if MCU clock ran fast
+		#endif
 		// float GetTemp();
 		int setMode(Mode Val); 
 		int getValue(int n);
+		int readSnapshot(Snapshot &Snap);
+		#if !defined(MCP79412_LEAN)
+		const Snapshot& getSnapshot() {return snapshot;} //Last snapshot taken by getValue()
+		#endif
+		int readOutage(Outage &Out, bool Clear = true); //Read and (by default) clear the power-fail stamps
 		int setAlarm(unsigned int Seconds, bool AlarmNum = 0); //Default to ALM0
+		int setAlarmAt(time_t Time, bool AlarmVal = 0); //Default to ALM0, must be within the next year
+		int setAlarmAt(const Timestamp &Time, bool AlarmVal = 0); //wday is ignored
+		int getAlarm(bool AlarmVal, AlarmInfo &Info);
+		#if !defined(MCP79412_LEAN)
+		int setRecurringAlarm(uint32_t Period, uint32_t Phase = 0, bool AlarmVal = 0); //Every Period seconds, aligned to the clock
+		int rearmRecurring(bool AlarmVal = 0);
+		#endif
 		int setMinuteAlarm(unsigned int Offset, bool AlarmVal = 0); //Default to ALM0
 		int setHourAlarm(unsigned int Offset, bool AlarmVal = 0); //Default to ALM0
 		int setDayAlarm(unsigned int Offset, bool AlarmVal = 0); //Default to ALM0
-		int enableAlarm(bool State = true, bool AlarmVal = 0); //Default to ALM0, enable
-		int clearAlarm(bool AlarmVal = 0); //Default to ALM0
-		bool readAlarm(bool AlarmVal = 0); //Default to ALM0
+		int commitAlarm(const AlarmBlock &Block, bool AlarmVal = 0) {stopRecurrence(AlarmVal); return writeAlarm(Block, alarmMap(AlarmVal));} //Default to ALM0, cancels any recurrence
+		int rearmAlarm(const AlarmBlock &Block, bool AlarmVal = 0) {return moveAlarm(Block, alarmMap(AlarmVal));} //Single write of the changed registers
+		int enableAlarm(bool State = true, bool AlarmVal = 0) {return setAlarmEnable(State, alarmMap(AlarmVal));} //Default to ALM0, enable
+		int clearAlarm(bool AlarmVal = 0) {return updateBits(alarmMap(AlarmVal).wkday, MCP79412Regs::ALMIF, 0);} //Default to ALM0, clear ALMxIF
+		bool readAlarm(bool AlarmVal = 0) {return readByte(alarmMap(AlarmVal).wkday) & MCP79412Regs::ALMIF;} //Default to ALM0, read ALMxIF
+
+		/**
+		 * Handle to one alarm, e.g. rtc.alarm<0>().rearm(Block). All of the alarm functions above are inline, so the 
+		 * register addresses and enable bit fold to constants at the call site and one shared implementation is used
+		 */
+		template <uint8_t N>
+		class Alarm
+		{
+			static_assert(N < 2, "MCP79412 has two alarms, ALM0 and ALM1");
+			public:
+				explicit Alarm(MCP79412 &Rtc) : rtc(Rtc) {}
+				int commit(const AlarmBlock &Block) {return rtc.commitAlarm(Block, N);}
+				int rearm(const AlarmBlock &Block) {return rtc.rearmAlarm(Block, N);}
+				int enable(bool State = true) {return rtc.enableAlarm(State, N);}
+				int clear() {return rtc.clearAlarm(N);} //Clear ALMxIF
+				bool flag() {return rtc.readAlarm(N);} //Read ALMxIF
+				int at(time_t Time) {return rtc.setAlarmAt(Time, N);}
+				int in(unsigned int Seconds) {return rtc.setAlarm(Seconds, N);}
+
+			private:
+				MCP79412 &rtc;
+		};
+		template <uint8_t N> Alarm<N> alarm() {return Alarm<N>(*this);}
+
+		typedef void (*AlarmCallback)(uint8_t AlarmNum, void *Context);
+		void onAlarm(bool AlarmVal, AlarmCallback Callback, void *Context = NULL); //Callback is run from serviceAlarms(), not the ISR, NULL to remove
+		int attachAlarmInterrupt(int Pin); //Call after setMode(), edge follows ALMPOL
+		void detachAlarmInterrupt();
+		void handleInterrupt() {alarmEvent.store(true, std::memory_order_release);} //ISR body, call directly if the MFP edge is caught by other means
+		bool alarmPending() const {return alarmEvent.load(std::memory_order_acquire);}
+		int serviceAlarms(); //Call from loop or a worker thread, no bus traffic unless the MFP has fired
+		#if defined(MCP79412_HAS_STRING)
 		String getUUIDString();
+		#endif
+		int formatUUID(char *Buffer, size_t Len);
 		uint64_t getUUID();
 
+		void enableRegisterCache(bool State = true); //Opt-in write-through cache of CONTROL, OSCTRIM and ALMxWKDAY config bits
+		void invalidateCache(); //Force next access of cached registers to go to the device
+		int syncCache(); //Reload cached registers from the device
+
+		constexpr static uint8_t SRAM_SIZE = 64; ///<Battery-backed SRAM, 0x20~0x5F
+		int readSram(uint8_t Offset, uint8_t *Data, size_t Len);
+		int writeSram(uint8_t Offset, const uint8_t *Data, size_t Len);
+		template<class T> int storeSram(uint8_t Offset, const T &Val); //Store POD with CRC, occupies sizeof(T) + 1 bytes
+		template<class T> int loadSram(uint8_t Offset, T &Val); //Load POD stored with storeSram, -2 if checksum fails
+		static uint8_t crc8(const uint8_t *Data, size_t Len, uint8_t Crc = 0xFF);
+
+		constexpr static uint8_t EEPROM_SIZE = 128; ///<User EEPROM array, 0x00~0x7F
+		constexpr static uint8_t EEPROM_PAGE = 8; ///<Write page size, writes must not cross a page boundary
+		int readEeprom(uint8_t Addr, uint8_t *Data, size_t Len);
+		int writeEeprom(uint8_t Addr, const uint8_t *Data, size_t Len);
+		int writeEepromAsync(uint8_t Addr, const uint8_t *Data, size_t Len); //Data must remain valid until updateEeprom() reports Done
+		AsyncStatus updateEeprom(); //Call periodically to complete an async write
+
+		#if !defined(MCP79412_LEAN)
+		constexpr static uint8_t JOURNAL_MAX_SLOTS = EEPROM_SIZE/EEPROM_PAGE; ///<One 8 byte record per page
+		int enableJournal(uint8_t Start = 0x00, uint8_t Slots = JOURNAL_MAX_SLOTS); //Call before begin(), which recovers the journal
+		int recoverJournal();
+		int appendJournal(uint8_t Type, uint32_t Value); //Type 0xFF is reserved
+		int readJournal(uint8_t Type, uint32_t &Value); //Newest value of given type, -2 if none
+		constexpr static uint8_t JOURNAL_TYPE_TRIM = 0xFE; ///<Journal record holding the trim, restored by begin() after total power loss
+		#endif
+
+		constexpr static float TRIM_PPM_PER_STEP = 1.017; ///<Each OSCTRIM step adds or removes 2 clocks per minute
+		int setTrim(int8_t Steps); //-127~127, positive adds clocks (speeds up clock)
+		int getTrim(int8_t &Steps);
+		int setCoarseTrim(bool State); //CRSTRIM, trim is applied 128 times a second, for calibration measurement only
+		#if !defined(MCP79412_LEAN)
+		constexpr static uint8_t CAL_MAX_POINTS = 8; ///<Calibration points kept, oldest is replaced
+		int addCalibrationPoint(int64_t RtcMs, int64_t RefMs); //RTC time and reference time of the same instant [ms]
+		int estimateDrift(float &Ppm); //Least-squares fit of the points, positive if the RTC runs fast
+		int calibrateTrim(uint32_t MinSpan = 604800); //Apply fitted drift to OSCTRIM, points must span at least MinSpan [s], a week by default
+		void clearCalibration() {calCount = 0; calBias = 0;}
+		#endif
+
 		uint8_t readByte(int Reg); //DEBUG! Make private
+		MCP79412Bus& getBus() {return *bus;} //Access to the transport, used for bus statistics
+
+		struct ErrorRecord {
+			uint32_t code;
+			uint16_t count; //Occurrences since last drain, saturates at 0xFFFF
+			uint32_t first; //millis() of first occurrence
+			uint32_t last; //millis() of most recent occurrence
+		};
+		typedef void (*ErrorVisitor)(const ErrorRecord &Record, void *Context);
 
         uint8_t getErrorsArray(uint32_t errors[]);
-        int throwError(uint32_t error);
-        uint32_t errors[MAX_NUM_ERRORS] = {0};
-		uint8_t numErrors = 0; //Used to track the index of errors array
+        int throwError(uint32_t error); //Safe to call from an ISR, see flushErrors()
+        int flushErrors(); //Write errors thrown where ISR context could not be detected to the SRAM log
+        uint8_t drainErrors(ErrorVisitor Visit, void *Context = NULL);
+        uint16_t takeDroppedErrors();
+        int enableSramErrorLog(uint8_t Offset, uint8_t Slots = 6); //Keep error ring in battery-backed SRAM, uses 3 + 4*Slots bytes
 		
 
 	private:
-		bool startOsc();
-		struct tm timeinfo = {0}; //Create struct in C++ time land
+		MCP79412Bus *bus; //Transport used for all communication with the device
+		int startOsc();
 		int writeByte(int Reg, uint8_t Val);
 		bool readBit(int Reg, uint8_t Pos);
 		int setBit(int Reg, uint8_t Pos);
 		int clearBit(int Reg, uint8_t Pos);
-		time_t timegm(struct tm *tm); //Portable implementation
-		time_t cstToUnix(int year, int month, int day, int hour, int minute, int second);
-		const int ADR = 0x6F; //Address of MCP79412 (non-variable)
-		const int ADR_EEPROM = 0x57; //Address of the embedded EEPROM 
-		int Time_Date[6]; //Store date time values of integers 
+		int updateBits(int Reg, uint8_t Clear, uint8_t Set);
+		int cacheSlot(int Reg);
+		void cacheStore(int Reg, uint8_t Val);
+		int readClock(time_t &Time, uint8_t *WDay = NULL);
+		int commitAlarmAt(time_t Time, time_t Now, uint8_t WDay, bool AlarmVal);
+		int waitEeprom();
+		int writeEepromPage();
+		int persistErrors();
+		void pushError(uint32_t Code, uint32_t Now);
+		void logError(uint32_t Code); //throwError() for driver code, never in an ISR so the SRAM log is written at once
+		uint8_t pendingErrors() const;
+		Timestamp currentTime();
+		constexpr static uint8_t ADR = 0x6F; //Address of MCP79412 (non-variable)
+		constexpr static uint8_t ADR_EEPROM = 0x57; //Address of the embedded EEPROM 
+		constexpr static uint32_t OSC_POLL_INTERVAL = 1; //Minimum time between OSCRUN reads [ms]
+		constexpr static uint32_t OSC_BEGIN_WAIT = 5; //Time begin() waits for the oscilator [ms]
+		AsyncStatus oscState = AsyncStatus::Failed; //Failed until beginAsync() is called
+		uint32_t oscStarted = 0; //millis() when oscilator was started
+		uint32_t oscPolled = 0; //millis() of last OSCRUN read
+		uint32_t oscTimeout = 0; //[ms]
+		constexpr static uint32_t EEPROM_WRITE_TIMEOUT = 10; //Max write cycle is 5ms [ms]
+		const uint8_t *eepromData = NULL; //Remaining data of the current async write, NULL if none in progress
+		uint8_t eepromAddr = 0;
+		uint8_t eepromRemaining = 0;
+		uint32_t eepromStarted = 0; //millis() at start of current page write cycle
+		bool eepromFailed = false;
+
+		struct ErrorSlot {
+			uint32_t code; //Written by the producer before the slot is published
+			uint32_t first;
+			std::atomic<uint32_t> last;
+			std::atomic<uint16_t> count; //0 while the slot is being filled or has been taken by the consumer
+		};
+		constexpr static uint8_t ERROR_QUEUE_SIZE = MAX_NUM_ERRORS > 0 ? MAX_NUM_ERRORS : 1; //One unused slot if there is no buffer, every error counts as dropped
+		constexpr static uint8_t ERROR_INDEX_WRAP = 2*ERROR_QUEUE_SIZE; //Indices run over twice the capacity so full and empty differ
+		ErrorSlot errorQueue[ERROR_QUEUE_SIZE] = {};
+		std::atomic<uint8_t> errorHead{0}; //Next index to reserve, advanced by producers
+		std::atomic<uint8_t> errorTail{0}; //Oldest unread index, advanced by the consumer only
+		std::atomic<uint16_t> errorsDropped{0};
+		std::atomic<bool> errorsDirty{false}; //SRAM log is behind the queue
+
+		friend struct MCP79412Check; //Host checks (extras/host) stage queue states an interrupted producer leaves behind
+		constexpr static uint8_t ERROR_LOG_MAGIC = 0xE5;
+		int8_t errorSramOffset = -1; //SRAM location of error ring, -1 if errors are only kept in RAM
+		uint8_t errorSlots = MAX_NUM_ERRORS; //Size of error ring in use
 
-		const uint8_t Control = 0x07;
+		#if !defined(MCP79412_LEAN)
+		int writeJournalRecord(uint8_t Type, uint32_t Value);
+		uint8_t journalStart = 0; //EEPROM address of first slot, page aligned
+		uint8_t journalSlots = 0; //0 if journal is not in use
+		uint8_t journalHead = 0; //Slot the next record is written to
+		uint16_t journalSeq = 1; //Sequence number of the next record
+		uint8_t journalTypes[JOURNAL_MAX_SLOTS]; //Record type held in each slot, 0xFF if empty or invalid
 
+		struct CalPoint {
+			int64_t ref; //Reference time [ms]
+			int32_t offset; //RTC - reference [ms], accumulated across time sets
+		};
+		CalPoint calPoints[CAL_MAX_POINTS];
+		uint8_t calCount = 0;
+		uint8_t calHead = 0; //Slot of next point
+		int32_t calBias = 0; //Offset carried over from before the last setTime() [ms]
+
+		constexpr static uint32_t SNAPSHOT_MAX_AGE = 250; //getValue() reuses its snapshot for this long [ms], so a run of calls reads one consistent time
+		Snapshot snapshot; //Used by getValue()
+		void invalidateSnapshot() {snapshot.valid = false;} //A register it holds has been written
+		#else
+		void invalidateSnapshot() {} //No snapshot is kept
+		#endif
+
+		constexpr static int CACHE_SIZE = 4; //CONTROL, OSCTRIM, ALM0WKDAY, ALM1WKDAY
+		bool cacheEnabled = false;
+		uint8_t cacheValid = 0; //Bit per cache slot
+		uint8_t cache[CACHE_SIZE] = {0};
+
+		#if !defined(MCP79412_LEAN)
+		bool anchorEnabled = false;
+		bool anchorValid = false;
+		bool anchorAligned = false; //Anchor was taken on a seconds edge, sub-second part is known
+		constexpr static uint32_t ANCHOR_POLL_INTERVAL = 1; //Time between seconds reads while waiting for the edge [ms]
+		time_t anchorTime = 0; //RTC time at anchor
+		uint32_t anchorMillis = 0; //millis() at anchor
+		uint32_t anchorInterval = 0; //Configured re-anchor period [ms]
+		uint32_t anchorActiveInterval = 0; //Current re-anchor period, shortened while drift exceeds limit [ms]
+		uint32_t anchorDriftLimit = 0; //[ms]
+		int32_t anchorDrift = 0; //[ms]
+
+		uint8_t alarmImage[2][6] = {{0}}; //Last block committed to each alarm, seconds through month
+		uint8_t alarmArmed = 0; //Bit per alarm, set while alarmImage matches the device and the alarm is enabled
+		uint32_t recurPeriod[2] = {0, 0}; //Period of recurring alarm [s], 0 if not recurring
+		uint32_t recurPhase[2] = {0, 0}; //[s], reduced modulo period
+		AlarmBlock recurringBlock(bool AlarmVal, time_t Now, uint8_t WDay) const;
+		void stopRecurrence(bool AlarmVal) {recurPeriod[AlarmVal] = 0;}
+		bool isRecurring(bool AlarmVal) const {return recurPeriod[AlarmVal] != 0;}
+		#else
+		void stopRecurrence(bool) {} //No recurring alarms
+		constexpr static bool isRecurring(bool) {return false;}
+		#endif
+		struct AlarmMap { //Registers of one alarm, see MCP79412Regs::Alarm
+			uint8_t num; //0 or 1
+			uint8_t sec; //First register of the block
+			uint8_t wkday;
+			uint8_t en; //ALMxEN in CONTROL
+		};
+		constexpr static AlarmMap alarmMap(bool AlarmVal) //No branch, folds to constants when AlarmVal is known
+		{
+			return {(uint8_t)AlarmVal, (uint8_t)(MCP79412Regs::Alarm<0>::SEC + AlarmVal*(MCP79412Regs::Alarm<1>::SEC - MCP79412Regs::Alarm<0>::SEC)), 
+				(uint8_t)(MCP79412Regs::Alarm<0>::SEC + AlarmVal*(MCP79412Regs::Alarm<1>::SEC - MCP79412Regs::Alarm<0>::SEC) + MCP79412Regs::ALMWKDAY), 
+				(uint8_t)(MCP79412Regs::Alarm<0>::EN << AlarmVal)};
+		}
+		int writeAlarm(const AlarmBlock &Block, AlarmMap Map);
+		int moveAlarm(const AlarmBlock &Block, AlarmMap Map);
+		int setAlarmEnable(bool State, AlarmMap Map);
+
+		std::atomic<bool> alarmEvent{false}; //Set by ISR, cleared by serviceAlarms()
+		int retryAlarms(int Error) {alarmEvent.store(true, std::memory_order_release); return -Error;} //Flags were left set, service again on next call
+		int alarmPin = -1; //Pin attached to MFP, -1 if none
+		AlarmCallback alarmCallbacks[2] = {NULL, NULL};
+		void *alarmContexts[2] = {NULL, NULL};
+		#if defined(ARDUINO) && !defined(PARTICLE)
+			static MCP79412 *alarmInstance; //attachInterrupt() takes no context, only one instance can be attached
+			static void alarmIsr() {if(alarmInstance != NULL) alarmInstance->handleInterrupt();}
+		#endif
         
 
 };
 
+#if defined(MCP79412_RAM_BUDGET)
+static_assert(sizeof(MCP79412) <= MCP79412_RAM_BUDGET, "MCP79412 instance exceeds MCP79412_RAM_BUDGET");
+#endif
+
+/**
+ * Store a POD value (struct, counter, etc) in battery-backed SRAM followed by a CRC-8, written in one burst
+ *
+ * @param Offset, location in SRAM (0~63)
+ * @param Val, the value to store
+ * @return int, the I2C status value (if any error occours), -1 if it does not fit in SRAM
+ */
+template<class T> int MCP79412::storeSram(uint8_t Offset, const T &Val)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be stored in SRAM");
+	static_assert(sizeof(T) < SRAM_SIZE, "Value (plus checksum) does not fit in SRAM");
+	uint8_t Buffer[sizeof(T) + 1];
+	memcpy(Buffer, &Val, sizeof(T));
+	Buffer[sizeof(T)] = crc8(Buffer, sizeof(T));
+	return writeSram(Offset, Buffer, sizeof(Buffer));
+}
+
+/**
+ * Load a POD value stored with storeSram, Val is only modified if the checksum is good
+ *
+ * @param Offset, location in SRAM (0~63)
+ * @param Val, where to place the value
+ * @return int, the I2C status value (if any error occours), -1 if it does not fit in SRAM, -2 if checksum fails (never stored or lost power)
+ */
+template<class T> int MCP79412::loadSram(uint8_t Offset, T &Val)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be stored in SRAM");
+	static_assert(sizeof(T) < SRAM_SIZE, "Value (plus checksum) does not fit in SRAM");
+	uint8_t Buffer[sizeof(T) + 1];
+	int Error = readSram(Offset, Buffer, sizeof(Buffer));
+	if(Error != 0) return Error;
+	if(crc8(Buffer, sizeof(T)) != Buffer[sizeof(T)]) return -2;
+	memcpy(&Val, Buffer, sizeof(T));
+	return 0;
+}
+
 #endif
\ No newline at end of file
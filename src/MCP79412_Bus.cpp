@@ -0,0 +1,305 @@
+/******************************************************************************
+MCP79412_Bus.cpp
+I2C transport layer for the MCP79412 driver
+Bobby Schulz @ GEMS Sensing
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#include "MCP79412_Bus.h"
+#include <string.h>
+
+#if !defined(PARTICLE) && !defined(ARDUINO)
+unsigned long millis()
+{
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (unsigned long)(Now.tv_sec*1000UL + Now.tv_nsec/1000000UL);
+}
+
+unsigned long micros()
+{
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (unsigned long)(Now.tv_sec*1000000UL + Now.tv_nsec/1000UL);
+}
+
+void delay(unsigned long ms)
+{
+	struct timespec Wait = {(time_t)(ms/1000), (long)((ms % 1000)*1000000L)};
+	nanosleep(&Wait, NULL);
+}
+#endif
+
+/**
+ * Read a block of registers, split into as many transfers as the backend buffer requires
+ *
+ * @param Adr, the 7 bit I2C address of the device
+ * @param Reg, the first register to read from (device auto-increments)
+ * @param Data, destination for the register values
+ * @param Len, number of registers to read
+ * @return int, the I2C status value (0 if all transfers succeeded)
+ */
+int MCP79412Bus::read(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len)
+{
+	Guard Lock(*this); //Keep chunks of one read together
+	size_t Chunk = maxTransfer();
+	while(Len > 0) {
+		size_t n = Len < Chunk ? Len : Chunk;
+		int Error = count(readRegs(Adr, Reg, Data, n));
+		if(Error != 0) return Error; //Stop on first failed transfer
+		stats.bytesRead += n;
+		Reg += n;
+		Data += n;
+		Len -= n;
+	}
+	return 0;
+}
+
+/**
+ * Write a block of registers, split into as many transfers as the backend buffer requires
+ *
+ * @param Adr, the 7 bit I2C address of the device
+ * @param Reg, the first register to write to (device auto-increments)
+ * @param Data, the register values to write
+ * @param Len, number of registers to write
+ * @return int, the I2C status value (0 if all transfers succeeded)
+ */
+int MCP79412Bus::write(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len)
+{
+	Guard Lock(*this);
+	size_t Chunk = maxTransfer() - 1; //Register pointer occupies one byte of the buffer
+	while(Len > 0) {
+		size_t n = Len < Chunk ? Len : Chunk;
+		int Error = count(writeRegs(Adr, Reg, Data, n));
+		if(Error != 0) return Error; //Stop on first failed transfer
+		stats.bytesWritten += n;
+		Reg += n;
+		Data += n;
+		Len -= n;
+	}
+	return 0;
+}
+
+/**
+ * Address the device without transferring data, used to check presence or poll for completion of internal writes
+ *
+ * @param Adr, the 7 bit I2C address of the device
+ * @return int, the I2C status value (0 if the device acknowledged)
+ */
+int MCP79412Bus::probe(uint8_t Adr)
+{
+	Guard Lock(*this);
+	return count(ping(Adr));
+}
+
+/**
+ * Write a single byte to a device which has no register pointer, such as the control register of an I2C mux
+ *
+ * @param Adr, the 7 bit I2C address of the device
+ * @param Val, the byte to write
+ * @return int, the I2C status value
+ */
+int MCP79412Bus::command(uint8_t Adr, uint8_t Val)
+{
+	Guard Lock(*this);
+	int Error = count(writeRegs(Adr, Val, NULL, 0)); //Value goes out in place of the register pointer
+	if(Error == 0) stats.bytesWritten++;
+	return Error;
+}
+
+/**
+ * Take the bus for exclusive use by this thread, recursive. Prefer MCP79412Bus::Guard, which can not be left locked
+ */
+void MCP79412Bus::lock()
+{
+	uint32_t Start = micros();
+	bool Contended = !tryLockBus();
+	if(Contended) lockBus(); //Held by another thread, block
+	if(lockDepth++ > 0) return; //Nested guard, already owned by this thread
+	uint32_t Wait = micros() - Start;
+	if(Contended || Wait >= CONTENDED_WAIT_US) stats.lockContended++; //Stats are only modified while the bus is held
+	stats.locks++;
+	stats.lockWaitUs += Wait;
+	if(Wait > stats.lockWaitMaxUs) stats.lockWaitMaxUs = Wait;
+}
+
+/**
+ * Release one level of the bus lock
+ */
+void MCP79412Bus::unlock()
+{
+	lockDepth--;
+	unlockBus();
+}
+
+int MCP79412Bus::count(int Error)
+{
+	stats.transactions++;
+	if(Error != 0) stats.errors++;
+	return Error;
+}
+
+MCP79412Mux::MCP79412Mux(MCP79412Bus &Parent, uint8_t Adr) : parent(Parent), adr(Adr), 
+	channels{{*this, 0}, {*this, 1}, {*this, 2}, {*this, 3}, {*this, 4}, {*this, 5}, {*this, 6}, {*this, 7}, {*this, NONE}}
+{
+
+}
+
+/**
+ * Route the bus to one downstream channel
+ *
+ * @param Channel, channel to select (0~7)
+ * @return int, the I2C status value, -1 if the channel is out of range
+ */
+int MCP79412Mux::select(uint8_t Channel)
+{
+	if(Channel >= CHANNELS) return -1;
+	if(selected == Channel) return 0; //Already routed, no traffic
+	MCP79412Bus::Guard Lock(parent);
+	int Error = parent.command(adr, (uint8_t)(1 << Channel)); //One bit per channel
+	selected = (Error == 0) ? Channel : NONE; //State of the mux is unknown after a failed write
+	return Error;
+}
+
+int MCP79412Mux::disable()
+{
+	MCP79412Bus::Guard Lock(parent);
+	int Error = parent.command(adr, 0x00);
+	selected = NONE;
+	return Error;
+}
+
+int MCP79412Mux::Channel::readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len)
+{
+	int Error = mux.select(num); //Parent is already held by this channel's guard
+	if(Error != 0) return Error;
+	return mux.parent.read(Adr, Reg, Data, Len);
+}
+
+int MCP79412Mux::Channel::writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len)
+{
+	int Error = mux.select(num);
+	if(Error != 0) return Error;
+	if(Len == 0) return mux.parent.command(Adr, Reg);
+	return mux.parent.write(Adr, Reg, Data, Len);
+}
+
+int MCP79412Mux::Channel::ping(uint8_t Adr)
+{
+	int Error = mux.select(num);
+	if(Error != 0) return Error;
+	return mux.parent.probe(Adr);
+}
+
+#if defined(MCP79412_HAS_WIRE)
+int MCP79412WireBus::begin()
+{
+	#if defined(ARDUINO) && ARDUINO >= 100
+		port.begin();
+	#elif defined(PARTICLE)
+		if(!port.isEnabled()) port.begin(); //Only initialize I2C if not done already //INCLUDE FOR USE WITH PARTICLE
+	#endif
+	return 0;
+}
+
+int MCP79412WireBus::readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len)
+{
+	port.beginTransmission(Adr); //Point to desired register
+	port.write(Reg);
+	int Error = port.endTransmission();
+	if(Error != 0) return Error;
+
+	size_t Received = port.requestFrom(Adr, (uint8_t)Len); //Blocks until transfer is complete
+	for(size_t i = 0; i < Received; i++) {
+		Data[i] = port.read();
+	}
+	if(Received < Len) return SHORT_READ;
+	return 0;
+}
+
+int MCP79412WireBus::writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len)
+{
+	port.beginTransmission(Adr);
+	port.write(Reg);
+	port.write(Data, Len); //Burst values, device auto-increments
+	return port.endTransmission(); //Return I2C status
+}
+
+int MCP79412WireBus::ping(uint8_t Adr)
+{
+	port.beginTransmission(Adr);
+	return port.endTransmission();
+}
+#endif
+
+uint8_t* MCP79412MemoryBus::memory(uint8_t Adr, size_t &Size)
+{
+	if(Adr == RTC_ADR) {
+		Size = RTC_SIZE;
+		return rtc;
+	}
+	if(Adr == EEPROM_ADR) {
+		Size = EEPROM_SIZE;
+		return eeprom;
+	}
+	return NULL;
+}
+
+int MCP79412MemoryBus::readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len)
+{
+	size_t Size = 0;
+	uint8_t *Mem = memory(Adr, Size);
+	if(Mem == NULL) return 2; //NACK on address
+	if(Adr == EEPROM_ADR && eepromBusy > 0) {
+		eepromBusy--;
+		return 2; //NACK during write cycle
+	}
+	if(Reg + Len > Size) return 3; //NACK on data, outside of implemented registers
+	memcpy(Data, Mem + Reg, Len);
+	return 0;
+}
+
+int MCP79412MemoryBus::writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len)
+{
+	size_t Size = 0;
+	uint8_t *Mem = memory(Adr, Size);
+	if(Mem == NULL) return 2; //NACK on address
+	if(Adr == EEPROM_ADR) {
+		if(eepromBusy > 0) {
+			eepromBusy--;
+			return 2; //NACK during write cycle
+		}
+		uint8_t PageStart = Reg & ~(EEPROM_PAGE - 1);
+		for(size_t i = 0; i < Len; i++) { //Address counter wraps within the page
+			eeprom[PageStart + ((Reg + i) & (EEPROM_PAGE - 1))] = Data[i];
+		}
+		eepromBusy = eepromWriteCycle;
+		return 0;
+	}
+	if(Reg + Len > Size) return 3; //NACK on data, outside of implemented registers
+	memcpy(Mem + Reg, Data, Len);
+	if(Adr == RTC_ADR) {
+		if(Reg <= 0x00 && Reg + Len > 0x00) { //OSCRUN (0x03 bit 5) follows ST (0x00 bit 7)
+			if(rtc[0x00] & 0x80) rtc[0x03] |= 0x20;
+			else rtc[0x03] &= ~0x20;
+		}
+		if(Reg <= 0x03 && Reg + Len > 0x03 && !(rtc[0x03] & 0x10)) memset(rtc + 0x18, 0, 8); //Clearing PWRFAIL clears the power-fail stamps
+		if(Reg <= 0x0D && Reg + Len > 0x0D) rtc[0x14] = (rtc[0x14] & 0x7F) | (rtc[0x0D] & 0x80); //ALMPOL is shared between the blocks
+		else if(Reg <= 0x14 && Reg + Len > 0x14) rtc[0x0D] = (rtc[0x0D] & 0x7F) | (rtc[0x14] & 0x80);
+	}
+	return 0;
+}
+
+int MCP79412MemoryBus::ping(uint8_t Adr)
+{
+	size_t Size = 0;
+	if(memory(Adr, Size) == NULL) return 2;
+	if(Adr == EEPROM_ADR && eepromBusy > 0) {
+		eepromBusy--;
+		return 2; //NACK during write cycle
+	}
+	return 0;
+}
@@ -0,0 +1,216 @@
+/******************************************************************************
+MCP79412_Bus.h
+I2C transport layer for the MCP79412 driver, allows the RTC to be placed on any bus (or a model of one)
+Bobby Schulz @ GEMS Sensing
+
+The driver talks to the RTC exclusively through the MCP79412Bus interface. Backends are provided for
+Particle/Arduino Wire, Linux i2c-dev (see MCP79412_LinuxBus.h) and an in-memory register model which
+can be used to run, profile and benchmark the driver on a host machine
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#ifndef MCP79412_Bus_h
+#define MCP79412_Bus_h
+
+#if defined(PARTICLE)
+	#include <Particle.h>
+	#define MCP79412_HAS_WIRE 1
+	#if !defined(MCP79412_LEAN)
+		#define MCP79412_HAS_STRING 1
+	#endif
+#elif defined(ARDUINO)
+	#include <Arduino.h>
+	#include <Wire.h>
+	#define MCP79412_HAS_WIRE 1
+	#if !defined(MCP79412_LEAN)
+		#define MCP79412_HAS_STRING 1
+	#endif
+#else //Host build, provide the few Arduino style helpers used by the driver
+	#include <stdint.h>
+	#include <stddef.h>
+	#include <time.h>
+	#include <mutex>
+	#define MCP79412_HAS_MUTEX 1
+	unsigned long millis();
+	unsigned long micros();
+	void delay(unsigned long ms);
+#endif
+
+class MCP79412Bus
+{
+	public:
+		constexpr static int SHORT_READ = 5; ///<Status returned when fewer bytes arrive than requested (Wire uses 1~4)
+		constexpr static uint32_t CONTENDED_WAIT_US = 100; ///<A lock which takes this long must have waited for another thread [us]
+
+		struct Stats {
+			uint32_t transactions; //Number of logical transfers (address phase + data burst) issued
+			uint32_t bytesRead; //Payload bytes read back from devices
+			uint32_t bytesWritten; //Payload bytes written, not including register pointer
+			uint32_t errors; //Transfers which returned a non-zero status
+			uint32_t locks; //Bus lock acquisitions (outermost only, nested guards are not counted)
+			uint32_t lockContended; //Acquisitions which found the bus held by another thread, or waited CONTENDED_WAIT_US or more (backends without try-lock, e.g. Particle)
+			uint32_t lockWaitUs; //Total time spent waiting for the bus [us]
+			uint32_t lockWaitMaxUs; //Longest single wait for the bus [us]
+		};
+
+		/**
+		 * RAII bus lock, held for the duration of one logical operation (read-modify-write, multi-register commit)
+		 * so no other thread's traffic can be interleaved with it. Guards nest, only the outermost takes the lock
+		 */
+		class Guard
+		{
+			public:
+				explicit Guard(MCP79412Bus &Bus) : bus(Bus) {bus.lock();}
+				~Guard() {bus.unlock();}
+				Guard(const Guard&) = delete;
+				Guard& operator=(const Guard&) = delete;
+			private:
+				MCP79412Bus &bus;
+		};
+
+		virtual ~MCP79412Bus() {}
+		virtual int begin() {return 0;} //Bring up the bus, if required
+		virtual size_t maxTransfer() const {return 32;} //Largest single transfer the backend can buffer (Wire default is 32 bytes)
+
+		int read(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len);
+		int write(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len);
+		int probe(uint8_t Adr);
+		int command(uint8_t Adr, uint8_t Val); //Single byte write with no register pointer (e.g. mux control register)
+
+		void lock();
+		void unlock();
+
+		const Stats& getStats() const {return stats;}
+		void resetStats() {stats = Stats();}
+
+	protected:
+		//Locking hooks, must be recursive. Default is a std::recursive_mutex on hosts and no locking otherwise
+		#if defined(MCP79412_HAS_MUTEX)
+			virtual bool tryLockBus() {return mutex.try_lock();}
+			virtual void lockBus() {mutex.lock();}
+			virtual void unlockBus() {mutex.unlock();}
+		#else
+			virtual bool tryLockBus() {lockBus(); return true;} //Backends which can not test the lock, contention is inferred from the wait
+			virtual void lockBus() {}
+			virtual void unlockBus() {}
+		#endif
+		virtual int readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len) = 0; //Single transfer, Len <= maxTransfer()
+		virtual int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) = 0; //Single transfer, Len < maxTransfer()
+		virtual int ping(uint8_t Adr) = 0; //Address only transfer, returns 0 on ACK
+
+	private:
+		int count(int Error);
+		Stats stats = {};
+		uint16_t lockDepth = 0; //Nesting of guards held by the owning thread, only touched while the bus is locked
+		#if defined(MCP79412_HAS_MUTEX)
+			std::recursive_mutex mutex;
+		#endif
+};
+
+#if defined(MCP79412_HAS_WIRE)
+class MCP79412WireBus : public MCP79412Bus
+{
+	public:
+		explicit MCP79412WireBus(TwoWire &Port) : port(Port) {}
+		int begin() override;
+
+	protected:
+		#if defined(PARTICLE)
+			void lockBus() override {port.lock();} //Device OS bus lock is recursive and shared with every other driver on the port
+			void unlockBus() override {port.unlock();}
+		#endif
+		int readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len) override;
+		int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) override;
+		int ping(uint8_t Adr) override;
+
+	private:
+		TwoWire &port;
+};
+#endif
+
+/**
+ * TCA9548A (or compatible) I2C mux, gives each downstream channel its own bus so a device behind the mux is used 
+ * exactly like one on a plain bus, e.g. MCP79412 Rtc(Mux, 3). The selected channel is cached so consecutive 
+ * transfers on one channel cost no extra traffic, switching channels costs one single byte write. Channel buses 
+ * hold the parent bus lock for each transfer, so channel switches can not be interleaved between threads
+ */
+class MCP79412Mux
+{
+	public:
+		constexpr static uint8_t ADR = 0x70; //Default address, A0~A2 low
+		constexpr static uint8_t CHANNELS = 8;
+		constexpr static uint8_t NONE = 0xFF; //No channel selected or selection unknown
+
+		explicit MCP79412Mux(MCP79412Bus &Parent, uint8_t Adr = ADR);
+		MCP79412Bus& channel(uint8_t Channel) {return channels[Channel < CHANNELS ? Channel : CHANNELS];} //Out of range channels fail every transfer with -1
+		int select(uint8_t Channel); //Only writes the mux if the channel differs from the cached selection
+		int disable(); //Deselect all channels
+		void invalidate() {selected = NONE;} //Call if the mux may have been changed by other code or reset
+		uint8_t getSelected() const {return selected;}
+
+	private:
+		class Channel : public MCP79412Bus
+		{
+			public:
+				Channel(MCP79412Mux &Mux, uint8_t Num) : mux(Mux), num(Num) {}
+				int begin() override {return mux.parent.begin();}
+				size_t maxTransfer() const override {return mux.parent.maxTransfer();}
+
+			protected:
+				bool tryLockBus() override {mux.parent.lock(); return true;} //Contention is counted by the parent
+				void lockBus() override {mux.parent.lock();}
+				void unlockBus() override {mux.parent.unlock();}
+				int readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len) override;
+				int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) override;
+				int ping(uint8_t Adr) override;
+
+			private:
+				MCP79412Mux &mux;
+				uint8_t num;
+		};
+
+		MCP79412Bus &parent;
+		uint8_t adr;
+		uint8_t selected = NONE;
+		Channel channels[CHANNELS + 1]; //Last is the invalid channel
+};
+
+/**
+ * Register level model of the MCP79412 (RTC at 0x6F, EEPROM at 0x57), used to run the driver without hardware.
+ * Registers are plain memory with the auto-increment behavior of the chip plus a few hardware side effects
+ * (OSCRUN follows ST, ALMPOL is mirrored between alarm blocks, clearing PWRFAIL clears the power-fail stamps). EEPROM writes wrap within an 8 byte page and 
+ * are followed by a write cycle during which the EEPROM does not acknowledge. Time does not advance on its own.
+ */
+class MCP79412MemoryBus : public MCP79412Bus
+{
+	public:
+		constexpr static uint8_t RTC_ADR = 0x6F;
+		constexpr static uint8_t EEPROM_ADR = 0x57;
+		constexpr static size_t RTC_SIZE = 0x60; //0x00~0x1F timekeeping, 0x20~0x5F SRAM
+		constexpr static size_t EEPROM_SIZE = 0x100; //0x00~0x7F user array, 0xF0~0xF7 EUI-64
+
+		constexpr static uint8_t EEPROM_PAGE = 8;
+
+		explicit MCP79412MemoryBus(size_t MaxTransfer = 32) : transferLimit(MaxTransfer) {}
+		size_t maxTransfer() const override {return transferLimit;}
+
+		uint8_t eepromWriteCycle = 3; //Number of transfers the EEPROM NACKs after a write, models the 5ms write cycle
+
+		uint8_t rtc[RTC_SIZE] = {0};
+		uint8_t eeprom[EEPROM_SIZE] = {0};
+
+	protected:
+		int readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len) override;
+		int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) override;
+		int ping(uint8_t Adr) override;
+
+	private:
+		uint8_t* memory(uint8_t Adr, size_t &Size);
+		size_t transferLimit;
+		uint8_t eepromBusy = 0; //Remaining transfers to NACK
+};
+
+#endif
@@ -0,0 +1,121 @@
+/******************************************************************************
+MCP79412_Codec.h
+Header-only BCD codec and calendar arithmetic shared by every read and write path of the MCP79412 driver
+Bobby Schulz @ GEMS Sensing
+
+All functions are constexpr (C++14) and branch-light so they inline into the register decode and can be
+verified at compile time, see static_asserts at end of file. Calendar functions use the proleptic Gregorian
+calendar, day counts are relative to 1970/1/1.
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#ifndef MCP79412_Codec_h
+#define MCP79412_Codec_h
+
+#include <stdint.h>
+
+namespace MCP79412Codec
+{
+	//Value masks for the time (0x00~0x06) and alarm (0x0A~0x0F, 0x11~0x16) registers, strips control and status bits
+	constexpr uint8_t SEC_MASK = 0x7F; //Bit 7 is ST (time) or unused (alarm)
+	constexpr uint8_t MIN_MASK = 0x7F;
+	constexpr uint8_t HOUR_MASK = 0x3F; //Bit 6 is 12/24, 24 hour mode only
+	constexpr uint8_t WDAY_MASK = 0x07; //Upper bits are OSCRUN, PWRFAIL, VBATEN (time) or ALMPOL, ALMxMSK, ALMxIF (alarm)
+	constexpr uint8_t DATE_MASK = 0x3F;
+	constexpr uint8_t MONTH_MASK = 0x1F; //Bit 5 is LPYR
+	constexpr uint8_t YEAR_MASK = 0xFF;
+
+	/**
+	 * Convert a binary value (0~99) to packed BCD
+	 */
+	constexpr uint8_t toBCD(uint8_t Val)
+	{
+		return (uint8_t)(((Val / 10) << 4) | (Val % 10));
+	}
+
+	/**
+	 * Convert a packed BCD register to binary, after applying the register mask
+	 */
+	constexpr uint8_t fromBCD(uint8_t Reg, uint8_t Mask = 0xFF)
+	{
+		return (uint8_t)(((Reg & Mask) >> 4) * 10 + (Reg & Mask & 0x0F));
+	}
+
+	constexpr bool isLeapYear(int32_t Year)
+	{
+		return (Year % 4 == 0) && ((Year % 100 != 0) || (Year % 400 == 0));
+	}
+
+	constexpr uint8_t daysInMonth(int32_t Year, uint8_t Month)
+	{
+		if(Month == 2) return isLeapYear(Year) ? 29 : 28;
+		return (uint8_t)(30 + ((Month ^ (Month >> 3)) & 0x01)); //31 on odd months through July, even months after
+	}
+
+	/**
+	 * Days since 1970/1/1 for a given civil date (negative before the epoch)
+	 */
+	constexpr int32_t daysFromCivil(int32_t Year, uint8_t Month, uint8_t Day)
+	{
+		Year -= Month <= 2; //Count years from March so the leap day is last
+		const int32_t Era = (Year >= 0 ? Year : Year - 399) / 400;
+		const uint32_t YoE = (uint32_t)(Year - Era * 400); //[0, 399]
+		const uint32_t DoY = (153 * (Month > 2 ? Month - 3 : Month + 9) + 2) / 5 + Day - 1; //[0, 365]
+		const uint32_t DoE = YoE * 365 + YoE / 4 - YoE / 100 + DoY; //[0, 146096]
+		return Era * 146097 + (int32_t)DoE - 719468;
+	}
+
+	/**
+	 * Day of week for a count of days since 1970/1/1, Monday = 1 ~ Sunday = 7
+	 */
+	constexpr uint8_t dayOfWeek(int32_t Days)
+	{
+		return (uint8_t)(((Days % 7) + 10) % 7 + 1); //1970/1/1 was a Thursday
+	}
+
+	/**
+	 * Day of year (1~366) for a civil date
+	 */
+	constexpr uint16_t dayOfYear(int32_t Year, uint8_t Month, uint8_t Day)
+	{
+		return (uint16_t)(daysFromCivil(Year, Month, Day) - daysFromCivil(Year, 1, 1) + 1);
+	}
+
+	struct Civil {
+		int32_t year;
+		uint8_t month; // 1-12
+		uint8_t day;   // 1-31
+	};
+
+	/**
+	 * Civil date for a count of days since 1970/1/1, inverse of daysFromCivil
+	 */
+	constexpr Civil civilFromDays(int32_t Days)
+	{
+		Days += 719468; //Shift epoch to 0000/3/1
+		const int32_t Era = (Days >= 0 ? Days : Days - 146096) / 146097;
+		const uint32_t DoE = (uint32_t)(Days - Era * 146097); //[0, 146096]
+		const uint32_t YoE = (DoE - DoE / 1460 + DoE / 36524 - DoE / 146096) / 365; //[0, 399]
+		const uint32_t DoY = DoE - (365 * YoE + YoE / 4 - YoE / 100); //[0, 365]
+		const uint32_t MP = (5 * DoY + 2) / 153; //Month from March [0, 11]
+		const uint8_t Month = (uint8_t)(MP < 10 ? MP + 3 : MP - 9);
+		return Civil{(int32_t)YoE + Era * 400 + (Month <= 2), Month, (uint8_t)(DoY - (153 * MP + 2) / 5 + 1)};
+	}
+
+	static_assert(toBCD(0) == 0x00 && toBCD(9) == 0x09 && toBCD(59) == 0x59 && toBCD(99) == 0x99, "BCD encode");
+	static_assert(fromBCD(0xD9, SEC_MASK) == 59 && fromBCD(0x63, HOUR_MASK) == 23 && fromBCD(0x32, MONTH_MASK) == 12, "BCD decode must strip control bits");
+	static_assert(fromBCD(toBCD(47)) == 47, "BCD round trip");
+	static_assert(isLeapYear(2024) && !isLeapYear(2100) && isLeapYear(2000) && !isLeapYear(2023), "Leap year");
+	static_assert(daysInMonth(2023, 1) == 31 && daysInMonth(2023, 2) == 28 && daysInMonth(2024, 2) == 29 && daysInMonth(2023, 4) == 30
+		&& daysInMonth(2023, 7) == 31 && daysInMonth(2023, 8) == 31 && daysInMonth(2023, 9) == 30 && daysInMonth(2023, 12) == 31, "Days in month");
+	static_assert(daysFromCivil(1970, 1, 1) == 0 && daysFromCivil(2000, 3, 1) == 11017 && daysFromCivil(1969, 12, 31) == -1, "Days from civil");
+	static_assert(dayOfWeek(0) == 4 && dayOfWeek(daysFromCivil(2024, 3, 4)) == 1 && dayOfWeek(-1) == 3, "Day of week");
+	static_assert(dayOfYear(2024, 12, 31) == 366 && dayOfYear(2023, 3, 1) == 60, "Day of year");
+	static_assert(civilFromDays(11017).year == 2000 && civilFromDays(11017).month == 3 && civilFromDays(11017).day == 1, "Civil from days");
+	static_assert(civilFromDays(daysFromCivil(2099, 12, 31)).day == 31 && civilFromDays(-1).year == 1969, "Civil round trip");
+}
+
+#endif
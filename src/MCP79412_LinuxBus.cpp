@@ -0,0 +1,67 @@
+/******************************************************************************
+MCP79412_LinuxBus.cpp
+Linux i2c-dev backend for the MCP79412 driver
+Bobby Schulz @ GEMS Sensing
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#include "MCP79412_LinuxBus.h"
+
+#if defined(__linux__) && !defined(PARTICLE) && !defined(ARDUINO)
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+MCP79412LinuxBus::~MCP79412LinuxBus()
+{
+	if(fd >= 0) close(fd);
+}
+
+/**
+ * Opens the i2c-dev character device, safe to call more than once
+ *
+ * @return int, 0 if the device is open, 4 (other error) otherwise
+ */
+int MCP79412LinuxBus::begin()
+{
+	if(fd < 0) fd = open(device, O_RDWR);
+	return fd < 0 ? 4 : 0;
+}
+
+int MCP79412LinuxBus::readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len)
+{
+	struct i2c_msg Msgs[2] = { //Pointer write and data read joined by a repeated start
+		{Adr, 0, 1, &Reg},
+		{Adr, I2C_M_RD, (uint16_t)Len, Data}
+	};
+	struct i2c_rdwr_ioctl_data Transfer = {Msgs, 2};
+	if(ioctl(fd, I2C_RDWR, &Transfer) < 0) return 2; //Kernel does not distinguish address from data NACK
+	return 0;
+}
+
+int MCP79412LinuxBus::writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len)
+{
+	uint8_t Buffer[64];
+	if(Len + 1 > sizeof(Buffer)) return 1; //Data too long
+	Buffer[0] = Reg;
+	memcpy(Buffer + 1, Data, Len);
+	struct i2c_msg Msg = {Adr, 0, (uint16_t)(Len + 1), Buffer};
+	struct i2c_rdwr_ioctl_data Transfer = {&Msg, 1};
+	if(ioctl(fd, I2C_RDWR, &Transfer) < 0) return 2;
+	return 0;
+}
+
+int MCP79412LinuxBus::ping(uint8_t Adr)
+{
+	struct i2c_msg Msg = {Adr, 0, 0, NULL}; //Zero length write, address phase only
+	struct i2c_rdwr_ioctl_data Transfer = {&Msg, 1};
+	if(ioctl(fd, I2C_RDWR, &Transfer) < 0) return 2;
+	return 0;
+}
+#endif
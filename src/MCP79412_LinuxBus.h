@@ -0,0 +1,36 @@
+/******************************************************************************
+MCP79412_LinuxBus.h
+Linux i2c-dev backend for the MCP79412 driver, allows the driver to run (and be profiled) on a Linux host
+Bobby Schulz @ GEMS Sensing
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#ifndef MCP79412_LinuxBus_h
+#define MCP79412_LinuxBus_h
+
+#include "MCP79412_Bus.h"
+
+#if defined(__linux__) && !defined(PARTICLE) && !defined(ARDUINO)
+class MCP79412LinuxBus : public MCP79412Bus
+{
+	public:
+		explicit MCP79412LinuxBus(const char *Device = "/dev/i2c-1") : device(Device) {}
+		~MCP79412LinuxBus() override;
+		int begin() override;
+		size_t maxTransfer() const override {return 64;} //Combined transfers are assembled in a stack buffer
+
+	protected:
+		int readRegs(uint8_t Adr, uint8_t Reg, uint8_t *Data, size_t Len) override;
+		int writeRegs(uint8_t Adr, uint8_t Reg, const uint8_t *Data, size_t Len) override;
+		int ping(uint8_t Adr) override;
+
+	private:
+		const char *device;
+		int fd = -1;
+};
+#endif
+
+#endif
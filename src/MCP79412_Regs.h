@@ -0,0 +1,83 @@
+/******************************************************************************
+MCP79412_Regs.h
+Compile-time register map of the MCP79412 (RTC at 0x6F)
+Bobby Schulz @ GEMS Sensing
+
+Addresses and bit masks from the MCP79412 datasheet (DS20002266), section 5. The two alarm blocks have the
+same layout 7 registers apart, MCP79412Regs::Alarm<N> resolves a block to constant addresses so code
+written against it carries no offset arithmetic or branches on the alarm number. Checked against the
+datasheet by the static_asserts at end of file.
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#ifndef MCP79412_Regs_h
+#define MCP79412_Regs_h
+
+#include <stdint.h>
+
+namespace MCP79412Regs
+{
+	//Timekeeping
+	constexpr uint8_t RTCSEC = 0x00;
+	constexpr uint8_t RTCMIN = 0x01;
+	constexpr uint8_t RTCHOUR = 0x02;
+	constexpr uint8_t RTCWKDAY = 0x03;
+	constexpr uint8_t RTCDATE = 0x04;
+	constexpr uint8_t RTCMTH = 0x05;
+	constexpr uint8_t RTCYEAR = 0x06;
+	constexpr uint8_t CONTROL = 0x07;
+	constexpr uint8_t OSCTRIM = 0x08;
+	constexpr uint8_t PWRDN = 0x18; //Power-down stamp, minutes through weekday/month
+	constexpr uint8_t PWRUP = 0x1C; //Power-up stamp
+	constexpr uint8_t SRAM = 0x20; //Battery-backed SRAM, 64 bytes
+	constexpr uint8_t SRAM_SIZE = 0x40;
+
+	//Position of each register within an alarm block (and the image staged for it), same order as RTCSEC~RTCMTH
+	constexpr uint8_t ALMSEC = 0;
+	constexpr uint8_t ALMMIN = 1;
+	constexpr uint8_t ALMHOUR = 2;
+	constexpr uint8_t ALMWKDAY = 3; //ALMPOL, ALMxMSK, ALMxIF, weekday
+	constexpr uint8_t ALMDATE = 4;
+	constexpr uint8_t ALMMTH = 5;
+
+	//Bits
+	constexpr uint8_t ST = 0x80; //RTCSEC, start oscilator
+	constexpr uint8_t OSCRUN = 0x20; //RTCWKDAY
+	constexpr uint8_t PWRFAIL = 0x10; //RTCWKDAY
+	constexpr uint8_t VBATEN = 0x08; //RTCWKDAY
+	constexpr uint8_t SQWEN = 0x40; //CONTROL
+	constexpr uint8_t EXTOSC = 0x08; //CONTROL
+	constexpr uint8_t CRSTRIM = 0x04; //CONTROL
+	constexpr uint8_t ALMPOL = 0x80; //ALMxWKDAY, shared by both blocks
+	constexpr uint8_t ALMMSK = 0x70; //ALMxWKDAY
+	constexpr uint8_t ALMMSK_POS = 4; //Lowest bit of ALMxMSK
+	constexpr uint8_t ALMIF = 0x08; //ALMxWKDAY
+
+	/**
+	 * Alarm block N (0 = ALM0 at 0x0A, 1 = ALM1 at 0x11), seconds through month
+	 */
+	template <uint8_t N>
+	struct Alarm
+	{
+		static_assert(N < 2, "MCP79412 has two alarms, ALM0 and ALM1");
+		constexpr static uint8_t SEC = 0x0A + 7*N;
+		constexpr static uint8_t MIN = SEC + ALMMIN;
+		constexpr static uint8_t HOUR = SEC + ALMHOUR;
+		constexpr static uint8_t WKDAY = SEC + ALMWKDAY;
+		constexpr static uint8_t DATE = SEC + ALMDATE;
+		constexpr static uint8_t MTH = SEC + ALMMTH;
+		constexpr static uint8_t SIZE = ALMMTH + 1;
+		constexpr static uint8_t EN = 0x10 << N; //ALMxEN in CONTROL
+		constexpr static uint8_t FIRED = 1 << N; //Bit in the serviceAlarms() mask
+	};
+
+	static_assert(Alarm<0>::WKDAY == 0x0D && Alarm<0>::MTH == 0x0F, "ALM0 block");
+	static_assert(Alarm<1>::SEC == 0x11 && Alarm<1>::WKDAY == 0x14 && Alarm<1>::MTH == 0x16, "ALM1 block");
+	static_assert(Alarm<0>::EN == 0x10 && Alarm<1>::EN == 0x20, "ALMxEN");
+	static_assert(PWRUP - PWRDN == 4 && SRAM + SRAM_SIZE == 0x60, "Power-fail stamps and SRAM");
+}
+
+#endif
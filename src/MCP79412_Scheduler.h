@@ -0,0 +1,306 @@
+/******************************************************************************
+MCP79412_Scheduler.h
+Software alarm scheduler for the MCP79412, multiplexes many logical timers onto one hardware alarm
+Bobby Schulz @ GEMS Sensing
+
+Timers are held in a min-heap keyed by absolute (Unix) time, the nearest deadline is always programmed into
+the hardware alarm. Each timer is either periodic (period + phase, so deadlines stay aligned to the clock) or
+one-shot. Timer configuration can be kept in the RTC's battery-backed SRAM (3 + 8*N bytes, up to 7 timers) so it 
+survives deep sleep and reset, handlers are bound again after boot with bind(). Typical use:
+
+	MCP79412Scheduler<4> Sched(rtc);
+	Sched.every(0, 600, 0, logData); //Every 10 minutes, on the 10 minutes
+	Sched.begin(0); //Restore from SRAM offset 0 (35 bytes), attach to ALM0 and arm
+	...
+	rtc.serviceAlarms(); //Dispatches to Sched.service() when the alarm fires
+
+Distributed as-is; no warranty is given.
+
+© 2023 Regents of the University of Minnesota. All rights reserved.
+******************************************************************************/
+
+#ifndef MCP79412_Scheduler_h
+#define MCP79412_Scheduler_h
+
+#include "MCP79412.h"
+
+template <uint8_t N>
+class MCP79412Scheduler
+{
+	static_assert(N > 0 && 3 + 8*N <= MCP79412::SRAM_SIZE, "Scheduler state must fit in SRAM (1~7 timers)");
+
+	public:
+		typedef void (*Handler)(uint8_t Id, void *Context);
+
+		explicit MCP79412Scheduler(MCP79412 &Rtc, bool AlarmVal = 0) : rtc(Rtc), alarmVal(AlarmVal) {}
+
+		/**
+		 * Start the scheduler, restores the persisted timers (if any), attaches to the alarm callback and arms the
+		 * nearest deadline. Timers which came due since the given time (e.g. while asleep) run immediately
+		 *
+		 * @param SramOffset, location of the persisted state in SRAM (0~63, 3 + 8*N bytes), -1 to keep state in RAM only
+		 * @param Since, time from which due timers are counted, 0 for now
+		 * @return int, the I2C status value (if any error occours), -1 if the state does not fit in SRAM
+		 */
+		int begin(int SramOffset = -1, time_t Since = 0)
+		{
+			if(SramOffset >= 0 && SramOffset + Size > MCP79412::SRAM_SIZE) return -1;
+			persistAddr = SramOffset;
+			if(persistAddr >= 0) restore();
+			rtc.onAlarm(alarmVal, dispatch, this);
+			time_t Now = 0;
+			uint8_t WDay = 0;
+			int Error = readNow(Now, WDay);
+			if(Error != 0) return Error;
+			for(uint8_t Id = 0; Id < N; Id++) {
+				if(used(Id)) deadline[Id] = nextDeadline(timers[Id], Since != 0 ? Since : Now);
+			}
+			heapify();
+			started = true;
+			Error = persist(); //Timers configured before begin()
+			if(Error != 0) return Error;
+			return service();
+		}
+
+		/**
+		 * Run a handler every Period seconds, on times where (t - Phase) % Period == 0, e.g. Period = 900, Phase = 300
+		 * runs at 5, 20, 35 and 50 minutes past the hour. Replaces any timer with the same Id
+		 *
+		 * @param Id, timer number (0~N-1)
+		 * @param Period, seconds between runs (> 0)
+		 * @param Phase, Unix time of any run (alignment)
+		 * @param Callback, called from service() with the Id and context
+		 * @param Context, passed through to the handler
+		 * @return int, the I2C status value (if any error occours), -1 if the Id or period is invalid
+		 */
+		int every(uint8_t Id, uint32_t Period, time_t Phase, Handler Callback, void *Context = NULL)
+		{
+			if(Period == 0) return -1;
+			return configure(Id, Period, Phase, Callback, Context);
+		}
+
+		/**
+		 * Run a handler once at a given time, it is removed after it runs. Replaces any timer with the same Id
+		 *
+		 * @param Id, timer number (0~N-1)
+		 * @param When, Unix time to run at (> 0), times in the past run on the next service()
+		 * @param Callback, called from service() with the Id and context
+		 * @param Context, passed through to the handler
+		 * @return int, the I2C status value (if any error occours), -1 if the Id or time is invalid
+		 */
+		int at(uint8_t Id, time_t When, Handler Callback, void *Context = NULL)
+		{
+			if(When <= 0) return -1;
+			return configure(Id, 0, When, Callback, Context);
+		}
+
+		/**
+		 * Attach a handler to a timer without changing its schedule, used after a restore from SRAM
+		 */
+		int bind(uint8_t Id, Handler Callback, void *Context = NULL)
+		{
+			if(Id >= N) return -1;
+			handlers[Id] = Callback;
+			contexts[Id] = Context;
+			return 0;
+		}
+
+		/**
+		 * Remove a timer
+		 *
+		 * @param Id, timer number (0~N-1)
+		 * @return int, the I2C status value (if any error occours), -1 if the Id is invalid
+		 */
+		int cancel(uint8_t Id)
+		{
+			return configure(Id, 0, 0, NULL, NULL);
+		}
+
+		/**
+		 * Run every handler which is due, reschedule periodic timers to their next aligned time and program the nearest
+		 * deadline into the alarm. Called through the alarm callback by MCP79412::serviceAlarms(), may also be polled.
+		 * A wake with one timer due is a single time read plus a single alarm write
+		 *
+		 * @return int, the I2C status value (if any error occours)
+		 */
+		int service()
+		{
+			time_t Now = 0;
+			uint8_t WDay = 0;
+			int Error = readNow(Now, WDay);
+			if(Error != 0) return Error;
+			const time_t Read = Now;
+			const uint32_t ReadMillis = millis();
+			bool Changed = false;
+			servicing = true;
+			while(count > 0 && deadline[heap[0]] <= Now) {
+				uint8_t Id = heap[0];
+				if(timers[Id].period == 0) { //One-shot, retire
+					timers[Id].phase = 0;
+					heap[0] = heap[--count];
+					Changed = true;
+				}
+				else deadline[Id] = nextDeadline(timers[Id], Now + 1);
+				siftDown(0);
+				if(handlers[Id] != NULL) handlers[Id](Id, contexts[Id]);
+				Now = Read + (millis() - ReadMillis)/1000; //Handlers take time, catch anything which came due meanwhile
+			}
+			servicing = false;
+			if(Changed) persist();
+			return arm(Read, WDay, Now);
+		}
+
+		time_t next() const {return count > 0 ? deadline[heap[0]] : 0;} //Nearest deadline, 0 if no timers
+		uint8_t size() const {return count;} //Number of active timers
+
+		static void dispatch(uint8_t AlarmNum, void *Context) //Alarm callback, see MCP79412::onAlarm()
+		{
+			(void)AlarmNum;
+			static_cast<MCP79412Scheduler*>(Context)->service();
+		}
+
+	private:
+		struct Timer {
+			uint32_t period; //0 for one-shot
+			time_t phase; //Alignment of periodic timers, time of one-shot
+		};
+
+		struct Stored { //Image kept in SRAM, followed by a CRC (see MCP79412::storeSram())
+			uint8_t magic;
+			uint8_t count;
+			uint8_t timers[N][8]; //Period, phase, little endian
+		};
+
+		constexpr static uint8_t MAGIC = 0x5C;
+		constexpr static uint8_t Size = sizeof(Stored) + 1;
+
+		MCP79412 &rtc;
+		bool alarmVal;
+		int persistAddr = -1;
+		bool started = false;
+		bool servicing = false;
+		Timer timers[N] = {};
+		Handler handlers[N] = {};
+		void *contexts[N] = {};
+		time_t deadline[N] = {};
+		uint8_t heap[N] = {}; //Ids of active timers, heap ordered by deadline
+		uint8_t count = 0;
+
+		bool used(uint8_t Id) const {return timers[Id].period != 0 || timers[Id].phase != 0;}
+
+		int configure(uint8_t Id, uint32_t Period, time_t Phase, Handler Callback, void *Context)
+		{
+			if(Id >= N) return -1;
+			timers[Id].period = Period;
+			timers[Id].phase = Phase;
+			handlers[Id] = Callback;
+			contexts[Id] = Context;
+			if(!started) return 0; //Scheduled and persisted by begin()
+			time_t Now = 0;
+			uint8_t WDay = 0;
+			int Error = readNow(Now, WDay);
+			if(Error != 0) return Error;
+			if(used(Id)) deadline[Id] = nextDeadline(timers[Id], Now);
+			heapify();
+			Error = persist();
+			if(Error != 0 || servicing) return Error; //service() arms once handlers are done
+			return arm(Now, WDay, Now);
+		}
+
+		/**
+		 * First run of a timer at or after a given time
+		 */
+		static time_t nextDeadline(const Timer &T, time_t From)
+		{
+			if(T.period == 0 || From <= T.phase) return T.phase;
+			uint32_t Periods = (uint32_t)((From - T.phase + T.period - 1) / T.period); //Round up, skips runs missed while asleep
+			return T.phase + (time_t)Periods * T.period;
+		}
+
+		/**
+		 * Program the nearest deadline, as a full match. The weekday is derived from the RTC's own weekday counter
+		 * at Read, since the application may number days differently than the calendar
+		 */
+		int arm(time_t Read, uint8_t WDay, time_t Now)
+		{
+			if(count == 0) return rtc.enableAlarm(false, alarmVal);
+			time_t Target = deadline[heap[0]];
+			if(Target <= Now) Target = Now + 1; //Came due while handlers ran, fire as soon as possible
+			MCP79412::AlarmBlock Block;
+			Block.at(Target, Read, WDay);
+			return rtc.rearmAlarm(Block, alarmVal);
+		}
+
+		int readNow(time_t &Now, uint8_t &WDay)
+		{
+			MCP79412::Snapshot Snap;
+			int Error = rtc.readSnapshot(Snap);
+			if(Error != 0) return Error;
+			Now = Snap.unixTime();
+			WDay = Snap.time().wday;
+			return 0;
+		}
+
+		void heapify()
+		{
+			count = 0;
+			for(uint8_t Id = 0; Id < N; Id++) {
+				if(used(Id)) heap[count++] = Id;
+			}
+			for(int i = count/2 - 1; i >= 0; i--) siftDown(i);
+		}
+
+		void siftDown(uint8_t i)
+		{
+			while(true) {
+				uint8_t Min = i;
+				uint8_t Left = 2*i + 1;
+				uint8_t Right = Left + 1;
+				if(Left < count && deadline[heap[Left]] < deadline[heap[Min]]) Min = Left;
+				if(Right < count && deadline[heap[Right]] < deadline[heap[Min]]) Min = Right;
+				if(Min == i) return;
+				uint8_t Temp = heap[i];
+				heap[i] = heap[Min];
+				heap[Min] = Temp;
+				i = Min;
+			}
+		}
+
+		/**
+		 * Write the timer configuration to SRAM, a single burst with no write cycle. Only called when the configuration 
+		 * changes (deadlines are derived, so servicing a periodic timer never writes)
+		 */
+		int persist()
+		{
+			if(persistAddr < 0 || !started) return 0;
+			Stored Image = {MAGIC, N, {}};
+			for(uint8_t Id = 0; Id < N; Id++) {
+				uint32_t Phase = (uint32_t)timers[Id].phase;
+				for(uint8_t i = 0; i < 4; i++) {
+					Image.timers[Id][i] = (uint8_t)(timers[Id].period >> (8*i));
+					Image.timers[Id][4 + i] = (uint8_t)(Phase >> (8*i));
+				}
+			}
+			return rtc.storeSram(persistAddr, Image);
+		}
+
+		void restore()
+		{
+			Stored Image;
+			if(rtc.loadSram(persistAddr, Image) != 0) return; //Never stored or VBAT was lost
+			if(Image.magic != MAGIC || Image.count != N) return;
+			for(uint8_t Id = 0; Id < N; Id++) {
+				if(used(Id)) continue; //Configured before begin(), takes precedence
+				uint32_t Period = 0;
+				uint32_t Phase = 0;
+				for(uint8_t i = 0; i < 4; i++) {
+					Period |= (uint32_t)Image.timers[Id][i] << (8*i);
+					Phase |= (uint32_t)Image.timers[Id][4 + i] << (8*i);
+				}
+				timers[Id].period = Period;
+				timers[Id].phase = (time_t)Phase;
+			}
+		}
+};
+
+#endif